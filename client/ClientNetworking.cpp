@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cctype>
 #include <chrono>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -454,6 +455,93 @@ bool fetch_motion_frame_jpeg(const std::string &endpoint,
   return perform_request(client_ptr);
 }
 
+bool stream_motion_frames(
+    const std::string &endpoint, const std::string &camera_name, float fps,
+    const std::function<bool(std::vector<unsigned char> &&)> &on_frame,
+    const std::function<bool(std::function<void()>)> &set_cancel) {
+  EndpointParts parts = parse_endpoint(endpoint);
+  if (parts.host.empty() || fps <= 0.0f) {
+    return false;
+  }
+
+  std::string path = join_paths(parts.base_path, "motion_stream");
+  path += "?name=" + camera_name + "&fps=" + std::to_string(fps);
+
+  // Each part is "--boundary\r\n<headers>\r\n\r\n<jpeg>\r\n"; the
+  // server always sends Content-Length so parts can be cut without scanning
+  // the JPEG for the boundary
+  std::string buffer;
+  bool stopped_by_caller = false;
+  auto receiver = [&](const char *data, size_t len) -> bool {
+    buffer.append(data, len);
+    while (true) {
+      size_t header_end = buffer.find("\r\n\r\n");
+      if (header_end == std::string::npos) {
+        return true;
+      }
+
+      std::string headers = buffer.substr(0, header_end);
+      std::transform(headers.begin(), headers.end(), headers.begin(),
+                     [](unsigned char c) { return std::tolower(c); });
+      size_t cl = headers.find("content-length:");
+      if (cl == std::string::npos) {
+        return false;
+      }
+      size_t body_len = std::strtoul(headers.c_str() + cl + 15, nullptr, 10);
+      size_t body_start = header_end + 4;
+      if (buffer.size() < body_start + body_len) {
+        return true;
+      }
+
+      std::vector<unsigned char> jpeg(buffer.begin() + body_start,
+                                      buffer.begin() + body_start + body_len);
+      buffer.erase(0, body_start + body_len);
+
+      if (DEBUG_MOTION_FRAME) {
+        std::cout << "[MotionStream] Part received: " << jpeg.size()
+                  << " bytes" << std::endl;
+      }
+      if (!on_frame(std::move(jpeg))) {
+        stopped_by_caller = true;
+        return false;
+      }
+    }
+  };
+
+  // A dedicated connection: the stream holds it open, so it can't share the
+  // cached keep-alive clients used for short requests
+  int read_timeout = 5 + static_cast<int>(1.0f / fps);
+  auto perform_request = [&](auto client_ptr) -> bool {
+    client_ptr->set_connection_timeout(5, 0);
+    client_ptr->set_read_timeout(read_timeout, 0);
+    client_ptr->set_write_timeout(5, 0);
+
+    // A quiet camera sends nothing for up to read_timeout; stop() shuts the
+    // socket down so the caller does not have to wait for the next part
+    if (!set_cancel([client_ptr]() { client_ptr->stop(); }))
+      return true;
+    client_ptr->Get(path.c_str(), receiver);
+    set_cancel(nullptr);
+    return stopped_by_caller;
+  };
+
+  std::string host = normalize_endpoint_for_cache(parts.host);
+#ifdef CPPHTTPLIB_OPENSSL_SUPPORT
+  if (parts.scheme == "https") {
+    auto client_ptr = std::make_shared<httplib::SSLClient>(host, parts.port);
+    client_ptr->enable_server_certificate_verification(false);
+    return perform_request(client_ptr);
+  }
+#endif
+
+  if (parts.scheme != "http") {
+    return false;
+  }
+
+  auto client_ptr = std::make_shared<httplib::Client>(host, parts.port);
+  return perform_request(client_ptr);
+}
+
 int add_motion_region(const std::string &endpoint,
                       const std::string &camera_name, int x, int y, int w,
                       int h, float angle) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <string>
 
 #include "ConfigurationPanel.h"
@@ -16,6 +17,15 @@ bool toggle_motion_detection(const std::string &endpoint,
 bool fetch_motion_frame_jpeg(const std::string &endpoint,
                              const std::string &camera_name,
                              std::vector<unsigned char> &jpeg_data);
+// Reads /motion_stream until on_frame returns false or the connection drops.
+// Returns true if the caller ended the stream, false on a network error.
+// set_cancel receives a function that aborts the open connection from any
+// thread before the request starts (return false to not start it), and an
+// empty one once the request is over.
+bool stream_motion_frames(
+    const std::string &endpoint, const std::string &camera_name, float fps,
+    const std::function<bool(std::vector<unsigned char> &&)> &on_frame,
+    const std::function<bool(std::function<void()>)> &set_cancel);
 int add_motion_region(const std::string &endpoint,
                       const std::string &camera_name, int x, int y, int w,
                       int h, float angle);
@@ -10,6 +10,7 @@
 #include <iomanip>
 #include <iostream>
 #include <mutex>
+#include <thread>
 #include <utility>
 
 #include "AsyncNetworkWorker.h"
@@ -89,7 +90,7 @@ ConfigurationPanel::ConfigurationPanel(
       probe_in_progress_(false), close_after_save_(false),
       last_server_camera_fetch_time_(0.0f),
       server_camera_fetch_in_progress_(false),
-      motion_frame_fetch_in_progress_(false), has_pending_motion_frame_(false),
+      motion_stream_generation_(0), has_pending_motion_frame_(false),
       pending_motion_frame_width_(0), pending_motion_frame_height_(0),
       motion_frame_fetch_interval_(1.0f),
       server_thread_info_fetch_in_progress_(false),
@@ -116,8 +117,27 @@ ConfigurationPanel::ConfigurationPanel(
                 endpoint);
 }
 
+ConfigurationPanel::~ConfigurationPanel() {
+  // Ends a running /motion_stream so the worker thread can be joined
+  stop_motion_stream_();
+}
+
+void ConfigurationPanel::stop_motion_stream_() {
+  if (motion_stream_key_.empty()) {
+    return;
+  }
+  motion_stream_generation_++;
+  motion_stream_key_.clear();
+
+  std::lock_guard<std::mutex> lock(motion_stream_cancel_mutex_);
+  if (motion_stream_cancel_) {
+    motion_stream_cancel_();
+  }
+}
+
 void ConfigurationPanel::render(bool &open) {
   if (!open) {
+    stop_motion_stream_();
     return;
   }
 
@@ -1021,6 +1041,7 @@ void ConfigurationPanel::renderMotionFrameTab(bool set_selected) {
                            "No cameras available on server");
         ImGui::Text("Server endpoint: %s", server_endpoint_.data());
       }
+      stop_motion_stream_();
       ImGui::EndTabItem();
       return;
     }
@@ -1117,7 +1138,7 @@ void ConfigurationPanel::renderMotionFrameTab(bool set_selected) {
                        &motion_frame_fetch_interval_, 0.1f, 5.0f, "%.1f");
     ImGui::PopItemWidth();
     if (ImGui::IsItemHovered())
-      ImGui::SetTooltip("How often to fetch motion frames from the server "
+      ImGui::SetTooltip("How often the server pushes motion frames "
                         "(lower = more frequent)");
 
     bool toggled = false;
@@ -1188,7 +1209,7 @@ void ConfigurationPanel::renderMotionFrameTab(bool set_selected) {
     if (motion_enabled && !toggled) {
       ImGui::Text("Motion Frame:");
 
-      // Fetch motion frame periodically using async network fetch
+      // Motion frames arrive over a streaming connection (see below)
       float current_time = ImGui::GetTime();
 
       // Process fetched JPEG data on main thread FIRST (decode + texture upload
@@ -1218,55 +1239,73 @@ void ConfigurationPanel::renderMotionFrameTab(bool set_selected) {
         MOTION_FRAME_LOG("Main thread: Decode complete, timestamp updated");
       }
 
-      // NOW check if we should start a new fetch (after processing any pending
-      // frame)
-      if (current_time - last_motion_frame_fetch_ >
-          motion_frame_fetch_interval_) {
-        if (!motion_frame_fetch_in_progress_ && motion_frame_worker_) {
-          MOTION_FRAME_LOG("Starting async fetch for camera: "
-                           << selected_camera.name << " (interval: "
-                           << motion_frame_fetch_interval_ << "s)");
-          motion_frame_fetch_in_progress_ = true;
-          // Don't update last_motion_frame_fetch_ here - will update after
-          // decode completes
+      // Keep one /motion_stream open for the selected camera; the server
+      // pushes each new frame, so there is no per-frame request to issue
+      std::string stream_key = selected_camera.name + "@" +
+                               std::to_string(motion_frame_fetch_interval_);
+      if (motion_frame_worker_) {
+        if (stream_key != motion_stream_key_) {
+          stop_motion_stream_();
+          motion_stream_key_ = stream_key;
+          uint64_t generation = ++motion_stream_generation_;
 
           std::string camera_name = selected_camera.name;
           std::string endpoint(server_endpoint_.data());
+          float fps = 1.0f / motion_frame_fetch_interval_;
+          MOTION_FRAME_LOG("Starting motion stream for camera: "
+                           << camera_name << " (" << fps << " fps)");
 
           // Use dedicated motion frame worker (not shared with other async
-          // tasks) This ensures motion frame fetching is never delayed by
-          // health checks, camera lists, etc.
-          motion_frame_worker_->enqueueTask([this, camera_name, endpoint]() {
-            MOTION_FRAME_LOG(
-                "Background thread: Fetching JPEG from network for "
-                << camera_name);
-            std::vector<unsigned char> jpeg_buffer;
-
-            // Network I/O happens in background - doesn't block UI
-            bool success = client_network::fetch_motion_frame_jpeg(
-                endpoint, camera_name, jpeg_buffer);
-
-            if (success && !jpeg_buffer.empty()) {
-              MOTION_FRAME_LOG("Background thread: JPEG fetch SUCCESS, size="
-                               << jpeg_buffer.size() << " bytes");
-              std::lock_guard<std::mutex> lock(motion_frame_mutex_);
-              motion_frame_data_ = std::move(jpeg_buffer);
-              has_pending_motion_frame_ = true;
-            } else {
-              MOTION_FRAME_LOG("Background thread: JPEG fetch FAILED");
+          // tasks): the stream occupies it until the generation changes
+          motion_frame_worker_->enqueueTask([this, camera_name, endpoint, fps,
+                                             generation]() {
+            auto current = [this, generation]() {
+              return motion_stream_generation_.load() == generation;
+            };
+
+            while (current()) {
+              bool ended = client_network::stream_motion_frames(
+                  endpoint, camera_name, fps,
+                  [this, &current](std::vector<unsigned char> &&jpeg) {
+                    if (!current())
+                      return false;
+                    MOTION_FRAME_LOG("Background thread: Stream frame, size="
+                                     << jpeg.size() << " bytes");
+                    std::lock_guard<std::mutex> lock(motion_frame_mutex_);
+                    motion_frame_data_ = std::move(jpeg);
+                    has_pending_motion_frame_ = true;
+                    return true;
+                  },
+                  [this, &current](std::function<void()> cancel) {
+                    // Checked under the lock so a stop either sees the
+                    // cancel function or this sees the new generation
+                    std::lock_guard<std::mutex> lock(
+                        motion_stream_cancel_mutex_);
+                    if (cancel && !current())
+                      return false;
+                    motion_stream_cancel_ = std::move(cancel);
+                    return true;
+                  });
+              if (ended)
+                break;
+
+              // Connection dropped or no frames; retry unless replaced
+              MOTION_FRAME_LOG("Background thread: Motion stream lost");
+              for (int i = 0; i < 10 && current(); ++i)
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
             }
-
-            motion_frame_fetch_in_progress_ = false;
-            MOTION_FRAME_LOG("Background thread: Fetch complete");
+            MOTION_FRAME_LOG("Background thread: Motion stream closed");
           });
-        } else if (!async_worker_ && fetch_motion_frame_callback_) {
-          MOTION_FRAME_LOG("Fallback: Synchronous fetch (no async worker)");
-          // Fallback: no async worker available, do synchronous fetch
-          last_motion_frame_fetch_ = current_time;
-          fetch_motion_frame_callback_(
-              selected_camera.name, motion_frame_texture_, motion_frame_width_,
-              motion_frame_height_);
         }
+      } else if (!async_worker_ && fetch_motion_frame_callback_ &&
+                 current_time - last_motion_frame_fetch_ >
+                     motion_frame_fetch_interval_) {
+        MOTION_FRAME_LOG("Fallback: Synchronous fetch (no async worker)");
+        // Fallback: no async worker available, do synchronous fetch
+        last_motion_frame_fetch_ = current_time;
+        fetch_motion_frame_callback_(selected_camera.name,
+                                     motion_frame_texture_, motion_frame_width_,
+                                     motion_frame_height_);
       }
 
       if (motion_frame_texture_ && motion_frame_width_ > 0 &&
@@ -1763,11 +1802,15 @@ void ConfigurationPanel::renderMotionFrameTab(bool set_selected) {
         ImGui::TextUnformatted(
             "Motion frame will appear when motion is detected.");
       }
-    } else if (!motion_enabled) {
-      ImGui::TextDisabled("Enable motion detection to view motion frames.");
+    } else {
+      stop_motion_stream_();
+      if (!motion_enabled)
+        ImGui::TextDisabled("Enable motion detection to view motion frames.");
     }
 
     ImGui::EndTabItem();
+  } else {
+    stop_motion_stream_();
   }
 }
 
@@ -2,6 +2,7 @@
 
 #include <array>
 #include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -127,6 +128,7 @@ public:
       std::function<bool(const std::string &)> clear_motion_regions_callback,
       std::function<std::vector<MotionRegion>(const std::string &)>
           get_motion_regions_callback);
+  ~ConfigurationPanel();
 
   void render(bool &open);
   void requestTab(Tab tab);
@@ -176,9 +178,18 @@ private:
   int motion_frame_width_;
   int motion_frame_height_;
   float last_motion_frame_fetch_;
-  bool motion_frame_fetch_in_progress_;
   float motion_frame_fetch_interval_;
 
+  // /motion_stream connection running on motion_frame_worker_. Bumping the
+  // generation ends the current stream; the key (camera + interval) tells the
+  // UI thread when it has to be restarted. The cancel function aborts the
+  // open connection, so a stopped stream does not wait for its next frame.
+  std::atomic<uint64_t> motion_stream_generation_;
+  std::string motion_stream_key_;
+  std::function<void()> motion_stream_cancel_;
+  std::mutex motion_stream_cancel_mutex_;
+  void stop_motion_stream_();
+
   // Motion frame data buffer (for async transfer)
   std::vector<unsigned char> motion_frame_data_;
   int pending_motion_frame_width_;
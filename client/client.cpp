@@ -2358,7 +2358,7 @@ int main(int argc, char **argv) {
       motion_thread.name = "  Motion Frame Worker";
       motion_thread.is_active = motion_worker->isRunning();
       if (motion_worker->isProcessing()) {
-        motion_thread.details = "Fetching motion frame";
+        motion_thread.details = "Streaming motion frames";
       } else {
         size_t queue_size = motion_worker->getQueueSize();
         if (queue_size > 0) {
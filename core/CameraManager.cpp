@@ -1,6 +1,8 @@
 #include "CameraManager.h"
 #include "PathUtils.h"
 #include "gstreamerRtspProxy.h"
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
@@ -17,6 +19,47 @@ CameraManager::CameraManager(Settings &settings)
     : settings_(settings), live555_proxy_() {
   gst_init(nullptr, nullptr);
 
+  // One main context for every bus watch and the RTSP proxy server
+  gst_runtime_ = std::make_unique<GstRuntime>();
+  gst_runtime_->start();
+  gstreamer_proxy_.setRuntime(gst_runtime_.get());
+
+  motion_scheduler_ =
+      std::make_unique<MotionScheduler>(settings_.motion_worker_threads());
+  motion_scheduler_->start();
+
+  auto gb = [](double v) {
+    return static_cast<uint64_t>(std::max(0.0, v) * 1024 * 1024 * 1024);
+  };
+  auto days = [](int d) {
+    return std::chrono::seconds(static_cast<int64_t>(std::max(0, d)) * 86400);
+  };
+  retention_ = std::make_unique<RetentionManager>(
+      core::PathUtils::getExecutableDir() + "/media",
+      RetentionPolicy{gb(settings_.retention_max_gb()),
+                      days(settings_.retention_max_days())},
+      RetentionPolicy{gb(settings_.retention_camera_max_gb()),
+                      days(settings_.retention_camera_max_days())},
+      std::chrono::seconds(settings_.retention_interval_seconds()));
+  retention_->start();
+
+  prober_ = std::make_unique<StreamProber>(
+      std::chrono::seconds(std::max(0, settings_.stream_probe_ttl_seconds())));
+
+  supervisor_ = std::make_unique<StreamSupervisor>(
+      std::chrono::seconds(settings_.stream_stall_seconds()),
+      std::chrono::seconds(settings_.reconnect_backoff_min_seconds()),
+      std::chrono::seconds(settings_.reconnect_backoff_max_seconds()));
+  supervisor_->start();
+
+  export_scheduler_ = std::make_unique<ExportScheduler>(
+      settings_.export_workers(),
+      static_cast<size_t>(std::max(1, settings_.export_queue_limit())));
+  RetentionManager *retention = retention_.get();
+  export_scheduler_->setOnExported(
+      [retention](const std::filesystem::path &path) { retention->add(path); });
+  export_scheduler_->start();
+
   // Check for CONFIG_PATH environment variable
   const char *env_config_path = std::getenv("CONFIG_PATH");
   if (env_config_path && *env_config_path) {
@@ -30,15 +73,26 @@ CameraManager::CameraManager(Settings &settings)
 }
 
 CameraManager::~CameraManager() {
-  stopAll();
+  // Let cameras still starting finish so none is left half set up
+  shutting_down_ = true;
+  if (startup_thread_.joinable())
+    startup_thread_.join();
+
+  stopAll(); // Cameras leave the supervisor as they stop
+  supervisor_->stop();
 
   gstreamer_proxy_.stop();
   live555_proxy_.stop();
+  motion_scheduler_->stop();
+  // Cameras are stopped, so nothing submits anymore; finish queued clips
+  export_scheduler_->stop();
+  retention_->stop();
+  gst_runtime_->stop(); // Last: the pipelines and proxy detached from it
 
   std::cout << "CameraManager exit after destructor" << std::endl;
 }
 
-void CameraManager::addCamera(
+bool CameraManager::addCamera(
     const std::string &name, const std::string &uri, bool segment,
     bool recording, bool overlay, bool motion_frame, bool gstreamerEncodedProxy,
     bool live555proxied, bool loading, int segment_bitrate,
@@ -46,27 +100,97 @@ void CameraManager::addCamera(
     const std::string &proxy_speed_preset, cv::Size motion_frame_size,
     float motion_frame_scale, float noise_threshold, float motion_threshold,
     int motion_min_hits, int motion_decay, float motion_arrow_scale,
-    int motion_arrow_thickness, std::string video_output_format,
+    int motion_arrow_thickness, int motion_fps,
+    MotionDecodeMode motion_decode_mode, bool preroll_recording,
+    bool segment_on_motion, std::string video_output_format,
     std::optional<AudioProbeResult> audio_hint) {
-  if (cameras_.find(name) != cameras_.end())
-    return;
+  {
+    std::lock_guard<std::mutex> lk(cameras_mutex_);
+    if (cameras_.find(name) != cameras_.end())
+      return false;
+    // A cameras.json entry that is still starting belongs to its worker
+    auto p = pending_.find(name);
+    if (!loading && p != pending_.end() && !p->second.failed)
+      return false;
+  }
 
   if (live555proxied && gstreamerEncodedProxy)
     std::cout << "Dont use live55proxy and gstreamer encodinga at once.";
 
-  std::string csName = name;
+  // Live555 serves the camera under its sanitized name
+  const bool useLive555 = live555proxied && !gstreamerEncodedProxy;
+  const bool useGstProxy = gstreamerEncodedProxy && !live555proxied;
+  std::string csName =
+      useLive555 ? core::PathUtils::sanitizeCameraName(name) : name;
+
+  // Unlocked: the audio probe and pipeline start can take seconds for a
+  // camera that doesn't answer. Cameras from cameras.json bring their last
+  // probe; new ones are probed here, or answered from the probe cache.
+  if (!audio_hint) {
+    StreamProbeResult probe = prober_->probe(uri);
+    std::cout << "[CameraManager] Stream " << uri
+              << " probed: " << (probe.audio.probed ? "yes" : "no")
+              << (probe.cached ? " (cached)" : "")
+              << ", has audio: " << (probe.audio.has_audio ? "yes" : "no")
+              << std::endl;
+    audio_hint = probe.audio;
+  }
+
+  auto cam = std::make_unique<CameraStream>(
+      csName, uri, settings_, segment, recording, overlay, motion_frame,
+      gstreamerEncodedProxy, live555proxied, proxy_bitrate, proxy_speed_preset,
+      segment_bitrate, segment_speed_preset, motion_frame_size,
+      motion_frame_scale, noise_threshold, motion_threshold, motion_min_hits,
+      motion_decay, motion_arrow_scale, motion_arrow_thickness, motion_fps,
+      motion_decode_mode, preroll_recording, segment_on_motion,
+      video_output_format);
+
+  cam->setAudioHint(*audio_hint);
+  cam->setMotionScheduler(motion_scheduler_.get());
+  cam->setExportScheduler(export_scheduler_.get());
+  cam->setRetentionManager(retention_.get());
+  cam->setStreamSupervisor(supervisor_.get());
+  cam->setGstRuntime(gst_runtime_.get());
+
+  // Set before start: the motion vector engine builds a different motion
+  // branch, and changing it later would rebuild the pipeline
+  if (loading) {
+    std::lock_guard<std::mutex> lk(cameras_mutex_);
+    auto p = pending_.find(name);
+    if (p != pending_.end())
+      cam->setMotionEngine(motionEngineFromString(p->second.entry.value(
+          "motion_engine", settings_.motion_engine())));
+  }
+
+  cam->start();
+
+  bool added = false;
+  {
+    std::lock_guard<std::mutex> lk(cameras_mutex_);
+    // Startup entries removed while starting are dropped
+    if (!loading || pending_.count(name))
+      added = cameras_.try_emplace(name, std::move(cam)).second;
+    if (added && !loading)
+      pending_.erase(name); // Re-added after a failed startup
+  }
+  if (!added) {
+    std::cout << "[CameraManager] Dropping camera '" << name
+              << "': added or removed while it was starting" << std::endl;
+    cam->stop();
+    return false;
+  }
 
-  // If Live555 proxying is requested, ensure Live555 is up
-  if (live555proxied && !gstreamerEncodedProxy) {
+  // Proxy mounts only for a committed camera: a dropped one would leave its
+  // mount behind, or unmount the camera that won the name
+  std::unique_lock<std::mutex> proxyLock(proxy_mutex_);
+  if (useLive555) {
     if (!live555_proxy_.isRunning()) {
       if (!live555_proxy_.start(live555_port_)) {
         std::cerr << "Live555 proxy failed to start on port " << live555_port_
                   << "\n";
       }
     }
-    // Sanitize and derive a stream name used in the Live555 server path
-    std::string sanitizeCameraName = core::PathUtils::sanitizeCameraName(name);
-    std::string streamName = "cam/" + sanitizeCameraName;
+    std::string streamName = "cam/" + csName;
 
     // Add the upstream -> proxy mapping
     if (!live555_proxy_.addStream(uri, streamName, /*forceBackendTCP=*/true)) {
@@ -76,38 +200,10 @@ void CameraManager::addCamera(
       auto url = live555_proxy_.streamUrl(streamName);
       if (!url.empty())
         std::cout << "Live555: " << name << " at " << url << "\n";
-
-      csName = sanitizeCameraName;
-    }
-  }
-
-  if (gstreamerEncodedProxy && !live555proxied) {
-    if (!gstreamer_proxy_.isRunning()) {
-      if (!gstreamer_proxy_.start(/*port*/ 8554)) {
-        std::cerr << "Failed to start GStreamer RTSP proxy on 8554\n";
-      }
     }
-    gstreamer_proxy_.addCameraProxy(name,
-                                    /*bitrate*/ proxy_bitrate,
-                                    /*speed_preset*/ proxy_speed_preset);
-  }
-
-  auto cam = std::make_unique<CameraStream>(
-      csName, uri, settings_, segment, recording, overlay, motion_frame,
-      gstreamerEncodedProxy, live555proxied, proxy_bitrate, proxy_speed_preset,
-      segment_bitrate, segment_speed_preset, motion_frame_size,
-      motion_frame_scale, noise_threshold, motion_threshold, motion_min_hits,
-      motion_decay, motion_arrow_scale, motion_arrow_thickness,
-      video_output_format);
-
-  if (audio_hint) {
-    cam->setAudioHint(*audio_hint);
   }
 
-  cam->start();
-  cameras_[name] = std::move(cam);
-
-  if (gstreamerEncodedProxy && !live555proxied) {
+  if (useGstProxy) {
     if (!gstreamer_proxy_.isRunning()) {
       if (!gstreamer_proxy_.start(8554)) {
         std::cerr << "Failed to start GStreamer RTSP proxy\n";
@@ -117,63 +213,83 @@ void CameraManager::addCamera(
       gstreamer_proxy_.addCameraProxy(name, proxy_bitrate, proxy_speed_preset);
     }
   }
+  proxyLock.unlock();
 
   if (!loading)
     saveCamerasToJSON(config_path_);
+  return true;
+}
+
+nlohmann::json CameraManager::cameraToJson(const CameraStream &cam) const {
+  nlohmann::json cam_json;
+  cam_json["name"] = cam.name();
+  cam_json["uri"] = cam.uri();
+  cam_json["segment"] = cam.segment();
+  cam_json["recording"] = cam.recording();
+  cam_json["overlay"] = cam.overlay();
+  cam_json["motion_frame"] = cam.motion_frame();
+  cam_json["preroll_recording"] = cam.preroll_recording();
+  cam_json["segment_on_motion"] = cam.segment_on_motion();
+  cam_json["gstreamerEncodedProxy"] = cam.getGstreamerEncodedProxy();
+  cam_json["live555proxied"] = cam.getLive555Proxied();
+
+  cam_json["segment_bitrate"] = cam.getSegmentBitrate();
+  cam_json["segment_speed_preset"] = cam.getSegmentSpeedPreset();
+  cam_json["proxy_bitrate"] = cam.getProxyBitrate();
+  cam_json["proxy_speed_preset"] = cam.getProxySpeedPreset();
+
+  cam_json["motion_frame_scale"] = cam.getMotionFrameScale();
+  cam_json["motion_fps"] = cam.getMotionFps();
+  cam_json["motion_decode_mode"] =
+      motionDecodeModeToString(cam.getMotionDecodeMode());
+  cam_json["motion_engine"] = motionEngineToString(cam.getMotionEngine());
+  cam_json["noise_threshold"] = cam.getNoiseThreshold();
+  cam_json["motion_threshold"] = cam.getMotionThreshold();
+  cam_json["motion_min_hits"] = cam.getMotionMinHits();
+  cam_json["motion_decay"] = cam.getMotionDecay();
+  cam_json["motion_arrow_scale"] = cam.getMotionArrowScale();
+  cam_json["motion_arrow_thickness"] = cam.getMotionArrowThickness();
+  cam_json["feature_redetect_interval"] = cam.getFeatureRedetectInterval();
+  cam_json["feature_min_survivor_ratio"] = cam.getFeatureMinSurvivorRatio();
+  cam_json["diff_gate_ratio"] = cam.getDiffGateRatio();
+  cam_json["diff_gate_pixel_threshold"] = cam.getDiffGatePixelThreshold();
+  cam_json["video_output_format"] = cam.getVideoOutputFormat();
+
+  cv::Size sz = cam.getMotionFrameSize();
+  cam_json["motion_frame_size"] = {sz.width, sz.height};
+
+  const auto &ap = cam.audioProbe();
+  cam_json["audio"] = {{"has_audio", ap.has_audio},
+                       {"encoding", ap.encoding},
+                       {"rate", ap.rate},
+                       {"channels", ap.channels}};
+
+  // Save motion regions
+  const auto &regions = cam.getMotionRegions();
+  cam_json["motion_regions"] = nlohmann::json::array();
+  for (const auto &region : regions) {
+    nlohmann::json region_json;
+    region_json["id"] = region.id;
+    region_json["x"] = region.rect.x;
+    region_json["y"] = region.rect.y;
+    region_json["w"] = region.rect.width;
+    region_json["h"] = region.rect.height;
+    region_json["angle"] = region.angle;
+    cam_json["motion_regions"].push_back(region_json);
+  }
+  return cam_json;
 }
 
 void CameraManager::saveCamerasToJSON(const std::string &filename) {
   nlohmann::json j;
-  for (const auto &pair : cameras_) {
-    const auto &cam = pair.second;
-    nlohmann::json cam_json;
-    cam_json["name"] = cam->name();
-    cam_json["uri"] = cam->uri();
-    cam_json["segment"] = cam->segment();
-    cam_json["recording"] = cam->recording();
-    cam_json["overlay"] = cam->overlay();
-    cam_json["motion_frame"] = cam->motion_frame();
-    cam_json["gstreamerEncodedProxy"] = cam->getGstreamerEncodedProxy();
-    cam_json["live555proxied"] = cam->getLive555Proxied();
-
-    cam_json["segment_bitrate"] = cam->getSegmentBitrate();
-    cam_json["segment_speed_preset"] = cam->getSegmentSpeedPreset();
-    cam_json["proxy_bitrate"] = cam->getProxyBitrate();
-    cam_json["proxy_speed_preset"] = cam->getProxySpeedPreset();
-
-    cam_json["motion_frame_scale"] = cam->getMotionFrameScale();
-    cam_json["noise_threshold"] = cam->getNoiseThreshold();
-    cam_json["motion_threshold"] = cam->getMotionThreshold();
-    cam_json["motion_min_hits"] = cam->getMotionMinHits();
-    cam_json["motion_decay"] = cam->getMotionDecay();
-    cam_json["motion_arrow_scale"] = cam->getMotionArrowScale();
-    cam_json["motion_arrow_thickness"] = cam->getMotionArrowThickness();
-    cam_json["video_output_format"] = cam->getVideoOutputFormat();
-
-    cv::Size sz = cam->getMotionFrameSize();
-    cam_json["motion_frame_size"] = {sz.width, sz.height};
-
-    const auto &ap = cam->audioProbe();
-    cam_json["audio"] = {{"has_audio", ap.has_audio},
-                         {"encoding", ap.encoding},
-                         {"rate", ap.rate},
-                         {"channels", ap.channels}};
-
-    // Save motion regions
-    const auto &regions = cam->getMotionRegions();
-    cam_json["motion_regions"] = nlohmann::json::array();
-    for (const auto &region : regions) {
-      nlohmann::json region_json;
-      region_json["id"] = region.id;
-      region_json["x"] = region.rect.x;
-      region_json["y"] = region.rect.y;
-      region_json["w"] = region.rect.width;
-      region_json["h"] = region.rect.height;
-      region_json["angle"] = region.angle;
-      cam_json["motion_regions"].push_back(region_json);
-    }
-
-    j["cameras"].push_back(cam_json);
+  {
+    std::lock_guard<std::mutex> lk(cameras_mutex_);
+    for (const auto &pair : cameras_)
+      if (!pending_.count(pair.first))
+        j["cameras"].push_back(cameraToJson(*pair.second));
+    // Still starting (or failed to): keep their entries as they were loaded
+    for (const auto &pair : pending_)
+      j["cameras"].push_back(pair.second.entry);
   }
   std::ofstream file(filename);
   if (file) {
@@ -206,59 +322,16 @@ void CameraManager::saveSingleCameraToJSON(const std::string &filename,
   }
 
   // Find the camera to update
-  auto it = cameras_.find(cameraName);
-  if (it == cameras_.end()) {
-    std::cerr << "Camera '" << cameraName << "' not found for JSON update"
-              << std::endl;
-    return;
-  }
-
-  const auto &cam = it->second;
   nlohmann::json cam_json;
-  cam_json["name"] = cam->name();
-  cam_json["uri"] = cam->uri();
-  cam_json["segment"] = cam->segment();
-  cam_json["recording"] = cam->recording();
-  cam_json["overlay"] = cam->overlay();
-  cam_json["motion_frame"] = cam->motion_frame();
-  cam_json["gstreamerEncodedProxy"] = cam->getGstreamerEncodedProxy();
-  cam_json["live555proxied"] = cam->getLive555Proxied();
-
-  cam_json["segment_bitrate"] = cam->getSegmentBitrate();
-  cam_json["segment_speed_preset"] = cam->getSegmentSpeedPreset();
-  cam_json["proxy_bitrate"] = cam->getProxyBitrate();
-  cam_json["proxy_speed_preset"] = cam->getProxySpeedPreset();
-
-  cam_json["motion_frame_scale"] = cam->getMotionFrameScale();
-  cam_json["noise_threshold"] = cam->getNoiseThreshold();
-  cam_json["motion_threshold"] = cam->getMotionThreshold();
-  cam_json["motion_min_hits"] = cam->getMotionMinHits();
-  cam_json["motion_decay"] = cam->getMotionDecay();
-  cam_json["motion_arrow_scale"] = cam->getMotionArrowScale();
-  cam_json["motion_arrow_thickness"] = cam->getMotionArrowThickness();
-  cam_json["video_output_format"] = cam->getVideoOutputFormat();
-
-  cv::Size sz = cam->getMotionFrameSize();
-  cam_json["motion_frame_size"] = {sz.width, sz.height};
-
-  const auto &ap = cam->audioProbe();
-  cam_json["audio"] = {{"has_audio", ap.has_audio},
-                       {"encoding", ap.encoding},
-                       {"rate", ap.rate},
-                       {"channels", ap.channels}};
-
-  // Save motion regions
-  const auto &regions = cam->getMotionRegions();
-  cam_json["motion_regions"] = nlohmann::json::array();
-  for (const auto &region : regions) {
-    nlohmann::json region_json;
-    region_json["id"] = region.id;
-    region_json["x"] = region.rect.x;
-    region_json["y"] = region.rect.y;
-    region_json["w"] = region.rect.width;
-    region_json["h"] = region.rect.height;
-    region_json["angle"] = region.angle;
-    cam_json["motion_regions"].push_back(region_json);
+  {
+    std::lock_guard<std::mutex> lk(cameras_mutex_);
+    auto it = cameras_.find(cameraName);
+    if (it == cameras_.end()) {
+      std::cerr << "Camera '" << cameraName << "' not found for JSON update"
+                << std::endl;
+      return;
+    }
+    cam_json = cameraToJson(*it->second);
   }
 
   // Find and replace existing camera entry, or add if not found
@@ -326,108 +399,216 @@ void CameraManager::loadCamerasFromJSON(const std::string &filename) {
   }
 
   if (j.contains("cameras") && j["cameras"].is_array()) {
-    for (const auto &entry : j["cameras"]) {
-      std::string name = entry.value("name", "");
-      std::string uri = entry.value("uri", "");
-      bool segment = entry.value("segment", false);
-      bool recording = entry.value("recording", false);
-      bool overlay = entry.value("overlay", false);
-      bool motion_frame = entry.value("motion_frame", false);
-      bool gstreamerEncodedProxy = entry.value("gstreamerEncodedProxy", false);
-      bool live555proxied = entry.value("live555proxied", false);
-
-      int segment_bitrate = entry.contains("segment_bitrate")
-                                ? entry["segment_bitrate"].get<int>()
-                                : settings_.segment_bitrate();
-      std::string segment_speed_preset =
-          entry.contains("segment_speed_preset")
-              ? entry["segment_speed_preset"].get<std::string>()
-              : settings_.segment_speedpreset();
-      int proxy_bitrate = entry.contains("proxy_bitrate")
-                              ? entry["proxy_bitrate"].get<int>()
-                              : settings_.proxy_bitrate();
-      std::string proxy_speed_preset =
-          entry.contains("proxy_speed_preset")
-              ? entry["proxy_speed_preset"].get<std::string>()
-              : settings_.proxy_speedpreset();
-
-      AudioProbeResult audio_hint;
-      bool have_audio_hint = false;
-      if (entry.contains("audio") && entry["audio"].is_object()) {
-        const auto &a = entry["audio"];
-        audio_hint.has_audio = a.value("has_audio", false);
-        audio_hint.encoding = a.value("encoding", std::string{});
-        audio_hint.rate = a.value("rate", 0);
-        audio_hint.channels = a.value("channels", 0);
-        audio_hint.probed = true;
-        have_audio_hint = true;
+    std::vector<nlohmann::json> entries;
+    {
+      std::lock_guard<std::mutex> lk(cameras_mutex_);
+      for (const auto &entry : j["cameras"]) {
+        std::string name = entry.value("name", "");
+        if (name.empty() || entry.value("uri", "").empty())
+          continue;
+        if (!pending_.emplace(name, PendingCamera{entry}).second) {
+          std::cerr << "[CameraManager] Duplicate camera '" << name
+                    << "' in cameras.json ignored" << std::endl;
+          continue;
+        }
+        entries.push_back(entry);
       }
+    }
 
-      float motion_frame_scale = entry.value("motion_frame_scale", 1.0f);
-      float noise_threshold = entry.value("noise_threshold", 0.0f);
-      float motion_threshold = entry.value("motion_threshold", 0.0f);
-      int motion_min_hits = entry.value("motion_min_hits", 1);
-      int motion_decay = entry.value("motion_decay", 0);
-      float motion_arrow_scale = entry.value("motion_arrow_scale", 2.5f);
-      int motion_arrow_thickness = entry.value("motion_arrow_thickness", 1);
-      std::string video_output_format =
-          entry.value("video_output_format", "mp4");
-
-      IntSize s = settings_.motionFrameSize();
-      cv::Size motion_frame_size(s.w, s.h);
-
-      if (entry.contains("motion_frame_size") &&
-          entry["motion_frame_size"].is_array()) {
-        auto arr = entry["motion_frame_size"];
-        if (arr.size() == 2)
-          motion_frame_size = cv::Size(arr[0], arr[1]);
-      }
+    // In the background, so the HTTP API is up while cameras connect
+    if (!entries.empty())
+      startup_thread_ =
+          std::thread(&CameraManager::startCameras, this, std::move(entries));
+  } else {
+    std::cerr << "Malformed cameras.json: 'cameras' array not found\n";
+  }
+}
 
-      if (!name.empty() && !uri.empty()) {
-        addCamera(name, uri, segment, recording, overlay, motion_frame,
-                  gstreamerEncodedProxy, live555proxied,
-                  /*loading=*/true, segment_bitrate, segment_speed_preset,
-                  proxy_bitrate, proxy_speed_preset, motion_frame_size,
-                  // --- New motion-related params:
-                  motion_frame_scale, noise_threshold, motion_threshold,
-                  motion_min_hits, motion_decay, motion_arrow_scale,
-                  motion_arrow_thickness, video_output_format,
-                  have_audio_hint ? std::optional<AudioProbeResult>{audio_hint}
-                                  : std::nullopt);
-
-        // Load motion regions after camera is added
-        if (entry.contains("motion_regions") &&
-            entry["motion_regions"].is_array()) {
-          for (const auto &region_json : entry["motion_regions"]) {
-            int x = region_json.value("x", 0);
-            int y = region_json.value("y", 0);
-            int w = region_json.value("w", 0);
-            int h = region_json.value("h", 0);
-            float angle = region_json.value("angle", 0.0f);
-            cv::Rect rect(x, y, w, h);
-            addMotionRegionToCamera(name, rect, angle);
-          }
+void CameraManager::startCameras(std::vector<nlohmann::json> entries) {
+  const auto t0 = std::chrono::steady_clock::now();
+  const size_t threads = std::min<size_t>(
+      entries.size(), std::max(1, settings_.camera_startup_threads()));
+  std::cout << "[CameraManager] Starting " << entries.size()
+            << " cameras on " << threads << " threads" << std::endl;
+
+  // Entries saved before their first probe answered: probe them all in one
+  // batch up front so the workers find them in the cache
+  std::vector<std::string> unprobed;
+  for (const auto &entry : entries)
+    if (!entry.contains("audio") || !entry["audio"].is_object())
+      unprobed.push_back(entry.value("uri", ""));
+  if (!unprobed.empty())
+    prober_->probe(unprobed);
+
+  // Each worker takes the next entry, so one camera timing out only holds
+  // up its own worker
+  std::atomic<size_t> next{0};
+  auto worker = [&] {
+    for (size_t i = next++; i < entries.size() && !shutting_down_;
+         i = next++) {
+      try {
+        loadCameraEntry(entries[i]);
+      } catch (const std::exception &e) {
+        // Bad entry or a camera that threw while starting: keep its entry
+        // and report it as failed
+        const std::string name = entries[i].value("name", "");
+        std::cerr << "[CameraManager] Camera '" << name
+                  << "' failed to start: " << e.what() << std::endl;
+        std::lock_guard<std::mutex> lk(cameras_mutex_);
+        auto it = pending_.find(name);
+        if (it != pending_.end()) {
+          it->second.failed = true;
+          it->second.error = e.what();
         }
       }
     }
-  } else {
-    std::cerr << "Malformed cameras.json: 'cameras' array not found\n";
+  };
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (auto &t : pool)
+    t.join();
+
+  const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - t0)
+                      .count();
+  std::cout << "[CameraManager] Camera startup finished in " << ms << " ms"
+            << std::endl;
+}
+
+void CameraManager::loadCameraEntry(const nlohmann::json &entry) {
+  std::string name = entry.value("name", "");
+  std::string uri = entry.value("uri", "");
+  bool segment = entry.value("segment", false);
+  bool recording = entry.value("recording", false);
+  bool overlay = entry.value("overlay", false);
+  bool motion_frame = entry.value("motion_frame", false);
+  bool preroll_recording = entry.value("preroll_recording", false);
+  bool segment_on_motion = entry.value("segment_on_motion", false);
+  bool gstreamerEncodedProxy = entry.value("gstreamerEncodedProxy", false);
+  bool live555proxied = entry.value("live555proxied", false);
+
+  int segment_bitrate = entry.contains("segment_bitrate")
+                            ? entry["segment_bitrate"].get<int>()
+                            : settings_.segment_bitrate();
+  std::string segment_speed_preset =
+      entry.contains("segment_speed_preset")
+          ? entry["segment_speed_preset"].get<std::string>()
+          : settings_.segment_speedpreset();
+  int proxy_bitrate = entry.contains("proxy_bitrate")
+                          ? entry["proxy_bitrate"].get<int>()
+                          : settings_.proxy_bitrate();
+  std::string proxy_speed_preset =
+      entry.contains("proxy_speed_preset")
+          ? entry["proxy_speed_preset"].get<std::string>()
+          : settings_.proxy_speedpreset();
+
+  AudioProbeResult audio_hint;
+  bool have_audio_hint = false;
+  if (entry.contains("audio") && entry["audio"].is_object()) {
+    const auto &a = entry["audio"];
+    audio_hint.has_audio = a.value("has_audio", false);
+    audio_hint.encoding = a.value("encoding", std::string{});
+    audio_hint.rate = a.value("rate", 0);
+    audio_hint.channels = a.value("channels", 0);
+    audio_hint.probed = true;
+    have_audio_hint = true;
+  }
+
+  float motion_frame_scale = entry.value("motion_frame_scale", 1.0f);
+  float noise_threshold = entry.value("noise_threshold", 0.0f);
+  float motion_threshold = entry.value("motion_threshold", 0.0f);
+  int motion_min_hits = entry.value("motion_min_hits", 1);
+  int motion_decay = entry.value("motion_decay", 0);
+  float motion_arrow_scale = entry.value("motion_arrow_scale", 2.5f);
+  int motion_arrow_thickness = entry.value("motion_arrow_thickness", 1);
+  int motion_fps = entry.value("motion_fps", settings_.motion_fps());
+  MotionDecodeMode motion_decode_mode = motionDecodeModeFromString(
+      entry.value("motion_decode_mode", settings_.motion_decode_mode()));
+  std::string video_output_format =
+      entry.value("video_output_format", "mp4");
+
+  IntSize s = settings_.motionFrameSize();
+  cv::Size motion_frame_size(s.w, s.h);
+
+  if (entry.contains("motion_frame_size") &&
+      entry["motion_frame_size"].is_array()) {
+    auto arr = entry["motion_frame_size"];
+    if (arr.size() == 2)
+      motion_frame_size = cv::Size(arr[0], arr[1]);
+  }
+
+  addCamera(name, uri, segment, recording, overlay, motion_frame,
+            gstreamerEncodedProxy, live555proxied,
+            /*loading=*/true, segment_bitrate, segment_speed_preset,
+            proxy_bitrate, proxy_speed_preset, motion_frame_size,
+            // --- New motion-related params:
+            motion_frame_scale, noise_threshold, motion_threshold,
+            motion_min_hits, motion_decay, motion_arrow_scale,
+            motion_arrow_thickness, motion_fps, motion_decode_mode,
+            preroll_recording, segment_on_motion, video_output_format,
+            have_audio_hint ? std::optional<AudioProbeResult>{audio_hint}
+                            : std::nullopt);
+
+  // Per-camera motion tuning overrides (defaults from settings)
+  if (CameraStream *cam = getCamera(name)) {
+    cam->setFeatureRedetectInterval(
+        entry.value("feature_redetect_interval",
+                    settings_.feature_redetect_interval()));
+    cam->setFeatureMinSurvivorRatio(
+        entry.value("feature_min_survivor_ratio",
+                    settings_.feature_min_survivor_ratio()));
+    cam->setDiffGateRatio(
+        entry.value("diff_gate_ratio", settings_.diff_gate_ratio()));
+    cam->setDiffGatePixelThreshold(
+        entry.value("diff_gate_pixel_threshold",
+                    settings_.diff_gate_pixel_threshold()));
   }
+
+  // Load motion regions after camera is added
+  if (entry.contains("motion_regions") &&
+      entry["motion_regions"].is_array()) {
+    for (const auto &region_json : entry["motion_regions"]) {
+      int x = region_json.value("x", 0);
+      int y = region_json.value("y", 0);
+      int w = region_json.value("w", 0);
+      int h = region_json.value("h", 0);
+      float angle = region_json.value("angle", 0.0f);
+      cv::Rect rect(x, y, w, h);
+      addMotionRegionToCamera(name, rect, angle);
+    }
+  }
+
+  // Fully set up (tuning and regions applied): saves serialize it from now on
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
+  pending_.erase(name);
 }
 
 void CameraManager::removeCamera(const std::string &name) {
   // Remove and stop CameraStream
-  auto it = cameras_.find(name);
+  std::unique_ptr<CameraStream> cam;
   bool was_gst_proxied = false;
   bool was_live555 = false;
 
-  if (it != cameras_.end()) {
-    was_gst_proxied = it->second->getGstreamerEncodedProxy();
-    was_live555 = it->second->getLive555Proxied();
-    it->second->stop();
-    cameras_.erase(it);
+  {
+    std::lock_guard<std::mutex> lk(cameras_mutex_);
+    pending_.erase(name); // Also drops a camera that failed to start
+    auto it = cameras_.find(name);
+    if (it != cameras_.end()) {
+      cam = std::move(it->second);
+      cameras_.erase(it);
+    }
+  }
+
+  if (cam) {
+    was_gst_proxied = cam->getGstreamerEncodedProxy();
+    was_live555 = cam->getLive555Proxied();
+    cam->stop();
+    cam.reset();
   }
 
+  std::unique_lock<std::mutex> proxyLock(proxy_mutex_);
   if (was_gst_proxied) {
     gstreamer_proxy_.removeCameraProxy(
         name); // just unmount, server keeps running
@@ -444,6 +625,8 @@ void CameraManager::removeCamera(const std::string &name) {
     }
   }
 
+  proxyLock.unlock();
+
   std::cout << "Closed stream /cam/" << name << std::endl;
 
   // Optionally: re-save cameras.json
@@ -451,30 +634,45 @@ void CameraManager::removeCamera(const std::string &name) {
 }
 
 CameraStream *CameraManager::getCamera(const std::string &name) {
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
   auto it = cameras_.find(name);
   if (it != cameras_.end())
     return it->second.get();
   return nullptr;
 }
 
+bool CameraManager::getMotionSnapshot(
+    const std::string &name, std::shared_ptr<const MotionSnapshot> &snapshot) {
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
+  auto it = cameras_.find(name);
+  if (it == cameras_.end())
+    return false;
+  snapshot = it->second->getMotionSnapshot();
+  return true;
+}
+
 void CameraManager::startAll() {
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
   for (auto &[_, cam] : cameras_)
     cam->start();
 }
 
 void CameraManager::stopAll() {
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
   for (auto &[_, cam] : cameras_)
     cam->stop();
 }
 
 std::vector<std::string> CameraManager::getCameraNames() const {
   std::vector<std::string> names;
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
   for (const auto &pair : cameras_)
     names.push_back(pair.first);
   return names;
 }
 nlohmann::json CameraManager::getCamerasInfoJson() const {
   json arr = json::array();
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
 
   for (const auto &kv : cameras_) {
     const auto &camPtr = kv.second;
@@ -485,10 +683,13 @@ nlohmann::json CameraManager::getCamerasInfoJson() const {
     json j;
     j["name"] = cam.name();
     j["uri"] = cam.uri();
+    j["state"] = cam.state();
     j["segment"] = cam.segment();
     j["recording"] = cam.recording();
     j["overlay"] = cam.overlay();
     j["motion_frame"] = cam.motion_frame();
+    j["preroll_recording"] = cam.preroll_recording();
+    j["segment_on_motion"] = cam.segment_on_motion();
     j["gstreamerEncodedProxy"] = cam.getGstreamerEncodedProxy();
     j["live555Proxied"] = cam.getLive555Proxied();
 
@@ -500,6 +701,10 @@ nlohmann::json CameraManager::getCamerasInfoJson() const {
     const cv::Size msz = cam.getMotionFrameSize();
     j["motion_frame_size"] = {msz.width, msz.height};
     j["motion_frame_scale"] = cam.getMotionFrameScale();
+    j["motion_fps"] = cam.getMotionFps();
+    j["motion_decode_mode"] =
+        motionDecodeModeToString(cam.getMotionDecodeMode());
+    j["motion_engine"] = motionEngineToString(cam.getMotionEngine());
 
     j["noise_threshold"] = cam.getNoiseThreshold();
     j["motion_threshold"] = cam.getMotionThreshold();
@@ -507,11 +712,36 @@ nlohmann::json CameraManager::getCamerasInfoJson() const {
     j["motion_decay"] = cam.getMotionDecay();
     j["motion_arrow_scale"] = cam.getMotionArrowScale();
     j["motion_arrow_thickness"] = cam.getMotionArrowThickness();
+    j["feature_redetect_interval"] = cam.getFeatureRedetectInterval();
+    j["feature_min_survivor_ratio"] = cam.getFeatureMinSurvivorRatio();
+    j["diff_gate_ratio"] = cam.getDiffGateRatio();
+    j["diff_gate_pixel_threshold"] = cam.getDiffGatePixelThreshold();
     j["video_output_format"] = cam.getVideoOutputFormat();
 
+    if (cam.recording()) {
+      const RecordingStats rs = cam.recordingStats();
+      j["continuous"] = {{"active", rs.active},
+                         {"current_file", rs.current_file},
+                         {"bytes_written", rs.bytes_written},
+                         {"files_written", rs.files_written},
+                         {"keyframes_indexed", rs.keyframes_indexed}};
+    }
+
+    const SupervisedStreamStats sv = cam.supervisorStats();
+    j["supervisor"] = {{"down", sv.down},
+                       {"failures", sv.failures},
+                       {"reconnects", sv.reconnects},
+                       {"downtime_seconds", sv.downtime_seconds},
+                       {"retry_in_seconds", sv.retry_in_seconds},
+                       {"last_error", sv.last_error}};
+
+    // Work this camera put on the shared GLib main context
+    const GstRuntimeOwnerStats rt = gst_runtime_->ownerStats(cam.name());
+    j["runtime"] = {{"dispatches", rt.dispatches}, {"cpu_ms", rt.cpu_ms}};
+
     // Helpful extras
     j["mount_point"] = cam.getMountPoint();
-    j["has_motion_frame"] = !cam.getLastMotionFrame().empty();
+    j["has_motion_frame"] = cam.hasMotionSnapshot();
 
     // If proxied via Live555, expose the RTSP URL the client can use
     if (cam.getLive555Proxied()) {
@@ -531,12 +761,161 @@ nlohmann::json CameraManager::getCamerasInfoJson() const {
     arr.push_back(std::move(j));
   }
 
+  // cameras.json entries not created yet, or whose creation threw
+  for (const auto &kv : pending_) {
+    if (cameras_.count(kv.first))
+      continue;
+    const PendingCamera &p = kv.second;
+    json j;
+    j["name"] = kv.first;
+    j["uri"] = p.entry.value("uri", "");
+    j["state"] = p.failed ? "failed" : "starting";
+    if (p.failed)
+      j["error"] = p.error;
+    arr.push_back(std::move(j));
+  }
+
+  return arr;
+}
+
+nlohmann::json CameraManager::getMotionStatsJson() const {
+  json arr = json::array();
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
+
+  for (const auto &kv : cameras_) {
+    const auto &cam = kv.second;
+    if (!cam)
+      continue;
+
+    const MotionStats st = cam->motionStats();
+    const uint64_t total = st.frames_gated + st.frames_analyzed;
+
+    json j;
+    j["name"] = cam->name();
+    j["motion_enabled"] = cam->motion_frame();
+    j["frames_gated"] = st.frames_gated;
+    j["frames_analyzed"] = st.frames_analyzed;
+    j["gated_ratio"] =
+        total ? static_cast<double>(st.frames_gated) / total : 0.0;
+    j["mat_allocs_per_analyzed_frame"] =
+        st.frames_analyzed
+            ? static_cast<double>(st.analyzed_mat_allocs) /
+                  st.frames_analyzed
+            : 0.0;
+    j["last_frame_mat_allocs"] = st.last_frame_mat_allocs;
+    j["engine"] = motionEngineToString(st.engine);
+    j["engine_ms_per_frame"] =
+        st.engine_frames
+            ? static_cast<double>(st.engine_us) / st.engine_frames / 1000.0
+            : 0.0;
+    j["last_engine_ms"] = st.last_engine_us / 1000.0;
+    if (st.engine == MotionEngine::MotionVectors) {
+      j["engine_fallback_frames"] = st.engine_fallbacks;
+      j["engine_units_dropped"] = st.engine_units_dropped;
+    }
+
+    json regions = json::array();
+    for (const RegionMotionScore &r : cam->regionMotionScores())
+      regions.push_back({{"region_id", r.region_id},
+                         {"score", r.score},
+                         {"points", r.points}});
+    j["regions"] = std::move(regions);
+
+    if (cam->preroll_recording()) {
+      const PrerollStats pr = cam->prerollStats();
+      j["preroll"] = {{"buffered_ms", pr.buffered_ms},
+                      {"buffered_bytes", pr.buffered_bytes},
+                      {"gops", pr.gops},
+                      {"recording", pr.recording},
+                      {"clips_written", pr.clips_written}};
+    }
+    if (cam->segment() && cam->segment_on_motion())
+      j["segment_gate_open"] = cam->segmentGateOpen();
+    arr.push_back(std::move(j));
+  }
+
+  return arr;
+}
+
+nlohmann::json CameraManager::getExportStatsJson() const {
+  const ExportStats st = export_scheduler_->stats();
+
+  json j;
+  j["workers"] = st.workers;
+  j["running"] = st.running;
+  j["queue_depth"] = st.queue_depth;
+  j["queue_limit"] = st.queue_limit;
+  j["submitted"] = st.submitted;
+  j["completed"] = st.completed;
+  j["failed"] = st.failed;
+  j["rejected"] = st.rejected;
+  j["avg_wait_ms"] = st.avg_wait_ms;
+  j["max_wait_ms"] = st.max_wait_ms;
+  j["bytes_exported"] = st.bytes_exported;
+  j["bytes_per_sec"] = st.bytes_per_sec;
+  return j;
+}
+
+nlohmann::json CameraManager::getStorageJson() const {
+  const RetentionUsage u = retention_->usage();
+  auto unixTime = [](std::chrono::system_clock::time_point t) {
+    return std::chrono::duration<double>(t.time_since_epoch()).count();
+  };
+  auto policyJson = [](const RetentionPolicy &p) {
+    return json{{"max_bytes", p.max_bytes},
+                {"max_age_seconds", p.max_age.count()}};
+  };
+
+  json j;
+  j["bytes"] = u.bytes;
+  j["files"] = u.files;
+  j["evicted_files"] = u.evicted_files;
+  j["evicted_bytes"] = u.evicted_bytes;
+  j["passes"] = u.passes;
+  j["global_quota"] = policyJson(retention_->globalPolicy());
+  j["camera_quota"] = policyJson(retention_->cameraPolicy());
+
+  json cams = json::array();
+  for (const auto &c : u.cameras) {
+    json cj;
+    cj["camera"] = c.camera;
+    cj["bytes"] = c.bytes;
+    cj["files"] = c.files;
+    if (c.files) {
+      cj["oldest"] = unixTime(c.oldest);
+      cj["newest"] = unixTime(c.newest);
+    }
+    cams.push_back(std::move(cj));
+  }
+  j["cameras"] = std::move(cams);
+  return j;
+}
+
+nlohmann::json
+CameraManager::probeStreamsJson(const std::vector<std::string> &uris) {
+  json arr = json::array();
+  for (const auto &r : prober_->probe(uris)) {
+    json j;
+    j["uri"] = r.uri;
+    j["probed"] = r.audio.probed;
+    j["cached"] = r.cached;
+    j["audio"] = {{"has_audio", r.audio.has_audio},
+                  {"encoding", r.audio.encoding},
+                  {"rate", r.audio.rate},
+                  {"channels", r.audio.channels}};
+    j["video"] = {{"encoding", r.video_encoding},
+                  {"width", r.width},
+                  {"height", r.height},
+                  {"fps", r.fps}};
+    arr.push_back(std::move(j));
+  }
   return arr;
 }
 
 int CameraManager::addMotionRegionToCamera(const std::string &cameraId,
                                            const cv::Rect &region,
                                            float angle) {
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
   auto it = cameras_.find(cameraId);
   if (it == cameras_.end()) {
     std::cout << "[CameraManager] Camera '" << cameraId
@@ -553,6 +932,7 @@ int CameraManager::addMotionRegionToCamera(const std::string &cameraId,
 
 bool CameraManager::removeMotionRegionFromCamera(const std::string &cameraId,
                                                  int regionId) {
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
   auto it = cameras_.find(cameraId);
   if (it == cameras_.end()) {
     std::cout << "[CameraManager] Camera '" << cameraId
@@ -569,6 +949,7 @@ bool CameraManager::removeMotionRegionFromCamera(const std::string &cameraId,
 }
 
 void CameraManager::clearMotionRegionsFromCamera(const std::string &cameraId) {
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
   auto it = cameras_.find(cameraId);
   if (it == cameras_.end()) {
     std::cout << "[CameraManager] Camera '" << cameraId
@@ -583,6 +964,7 @@ void CameraManager::clearMotionRegionsFromCamera(const std::string &cameraId) {
 
 std::vector<MotionRegion>
 CameraManager::getMotionRegionsFromCamera(const std::string &cameraId) const {
+  std::lock_guard<std::mutex> lk(cameras_mutex_);
   auto it = cameras_.find(cameraId);
   if (it == cameras_.end()) {
     std::cout << "[CameraManager] Camera '" << cameraId
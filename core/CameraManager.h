@@ -1,13 +1,22 @@
 #pragma once
 
 #include "CameraStream.h"
+#include "ExportScheduler.h"
+#include "GstRuntime.h"
+#include "MotionScheduler.h"
+#include "RetentionManager.h"
 #include "Settings.h"
+#include "StreamProber.h"
+#include "StreamSupervisor.h"
 #include "gstreamerRtspProxy.h"
 #include "live555RtspProxy.h"
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
 class CameraManager {
@@ -17,10 +26,17 @@ public:
 
   void removeCamera(const std::string &name);
   CameraStream *getCamera(const std::string &name);
+  // The camera's latest motion snapshot (null until it has one), read under
+  // the cameras lock so removeCamera() cannot free the camera mid-call.
+  // False if there is no such camera.
+  bool getMotionSnapshot(const std::string &name,
+                         std::shared_ptr<const MotionSnapshot> &snapshot);
 
   void startAll();
   void stopAll();
-  void addCamera(const std::string &name, const std::string &uri, bool segment,
+  // False if the name is taken: an existing camera, one still starting
+  // from cameras.json, or one added or removed while this one started
+  bool addCamera(const std::string &name, const std::string &uri, bool segment,
                  bool recording, bool overlay, bool motion_frame,
                  bool gstreamerEncodedProxy, bool live555proxied, bool loading,
                  int segment_bitrate, const std::string &segment_speed_preset,
@@ -29,18 +45,35 @@ public:
                  float noise_threshold, float motion_threshold,
                  int motion_min_hits, int motion_decay,
                  float motion_arrow_scale, int motion_arrow_thickness,
+                 int motion_fps, MotionDecodeMode motion_decode_mode,
+                 bool preroll_recording, bool segment_on_motion,
                  std::string video_output_format,
                  std::optional<AudioProbeResult> audio_hint = std::nullopt);
 
   std::vector<std::string> getCameraNames() const;
 
-  // Load previously added cameras when cameramanager is created
+  // Load previously added cameras when cameramanager is created. Returns
+  // right away; cameras start in the background on a bounded pool and show
+  // up as "starting" in getCamerasInfoJson() until they are up.
   std::string config_path_;
   void loadCamerasFromJSON(const std::string &path);
 
   // JSON array with one object per camera (see implementation for fields)
   nlohmann::json getCamerasInfoJson() const;
 
+  // JSON array with per-camera motion loop counters
+  nlohmann::json getMotionStatsJson() const;
+
+  // JSON object with export queue/backpressure counters
+  nlohmann::json getExportStatsJson() const;
+
+  // JSON object with recording disk usage and retention quotas
+  nlohmann::json getStorageJson() const;
+
+  // Probes the URIs concurrently (cached per URI); JSON array of results.
+  // Probing ahead of /add_camera lets the adds answer from the cache.
+  nlohmann::json probeStreamsJson(const std::vector<std::string> &uris);
+
   // Motion region management
   int addMotionRegionToCamera(const std::string &cameraId,
                               const cv::Rect &region, float angle = 0.0f);
@@ -53,9 +86,39 @@ public:
   void saveSingleCameraToJSON(const std::string &filename,
                               const std::string &cameraName);
 
+  const MotionScheduler &motionScheduler() const { return *motion_scheduler_; }
+  const ExportScheduler &exportScheduler() const { return *export_scheduler_; }
+  const RetentionManager &retention() const { return *retention_; }
+  const StreamSupervisor &supervisor() const { return *supervisor_; }
+  const GstRuntime &gstRuntime() const { return *gst_runtime_; }
+
 private:
+  // Declared before cameras_ so they outlive every CameraStream using them
+  std::unique_ptr<GstRuntime> gst_runtime_;
+  std::unique_ptr<MotionScheduler> motion_scheduler_;
+  std::unique_ptr<ExportScheduler> export_scheduler_;
+  std::unique_ptr<RetentionManager> retention_;
+  std::unique_ptr<StreamProber> prober_;
+  std::unique_ptr<StreamSupervisor> supervisor_;
   std::map<std::string, std::unique_ptr<CameraStream>> cameras_;
+  mutable std::mutex cameras_mutex_; // Guards cameras_ and pending_
+
+  // cameras.json entries still being started (or whose CameraStream could
+  // not be created). Kept so saving the config never drops them.
+  struct PendingCamera {
+    nlohmann::json entry;
+    bool failed = false;
+    std::string error;
+  };
+  std::map<std::string, PendingCamera> pending_;
+  std::thread startup_thread_;
+  std::atomic<bool> shutting_down_{false};
+
+  void startCameras(std::vector<nlohmann::json> entries);
+  void loadCameraEntry(const nlohmann::json &entry);
+  nlohmann::json cameraToJson(const CameraStream &cam) const;
 
+  std::mutex proxy_mutex_; // Serializes proxy setup across startup workers
   GstreamerRtspProxy gstreamer_proxy_;
 
   Settings &settings_;
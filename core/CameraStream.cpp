@@ -1,11 +1,13 @@
 #include "CameraStream.h"
+#include "MatAllocationCounter.h"
+#include "MotionScheduler.h"
 #include "PathUtils.h"
 #include "SegmentWorker.h"
 #include "VideoExporter.h"
 #include <algorithm>
 #include <atomic>
 #include <chrono>
-#include <condition_variable>
+#include <cstdio>
 #include <gst/app/gstappsink.h>
 #include <gst/gst.h>
 #include <iomanip>
@@ -13,6 +15,26 @@
 #include <mutex>
 #include <sstream>
 
+const char *motionDecodeModeToString(MotionDecodeMode mode) {
+  switch (mode) {
+  case MotionDecodeMode::NonReference:
+    return "nonref";
+  case MotionDecodeMode::KeyframesOnly:
+    return "keyframe";
+  case MotionDecodeMode::Full:
+  default:
+    return "full";
+  }
+}
+
+MotionDecodeMode motionDecodeModeFromString(const std::string &s) {
+  if (s == "nonref")
+    return MotionDecodeMode::NonReference;
+  if (s == "keyframe")
+    return MotionDecodeMode::KeyframesOnly;
+  return MotionDecodeMode::Full;
+}
+
 CameraStream::CameraStream(
     const std::string &name, const std::string &uri, Settings &settings,
     bool segment, bool recording, bool overlay, bool motion_frame,
@@ -21,7 +43,9 @@ CameraStream::CameraStream(
     std::string segment_speed_preset, cv::Size motion_frame_size,
     float motion_frame_scale, float noise_threshold, float motion_threshold,
     int motion_min_hits, int motion_decay, float motion_arrow_scale,
-    int motion_arrow_thickness, std::string video_output_format)
+    int motion_arrow_thickness, int motion_fps,
+    MotionDecodeMode motion_decode_mode, bool preroll_recording,
+    bool segment_on_motion, std::string video_output_format)
     : name_(name), uri_(uri), settings_(settings), mount_point_("/" + name),
       segment_(segment), recording_(recording), overlay_(overlay),
       motion_frame_(motion_frame),
@@ -35,14 +59,17 @@ CameraStream::CameraStream(
       noise_threshold_(noise_threshold), motion_threshold_(motion_threshold),
       motion_min_hits_(motion_min_hits), motion_decay_(motion_decay),
       motion_arrow_scale_(motion_arrow_scale),
-      motion_arrow_thickness_(motion_arrow_thickness),
+      motion_arrow_thickness_(motion_arrow_thickness), motion_fps_(motion_fps),
+      motion_decode_mode_(motion_decode_mode),
+      preroll_recording_(preroll_recording),
+      segment_on_motion_(segment_on_motion),
       video_output_format_(video_output_format) {
 
-  // Probe stream for audio
-  ProbeRtspAudio(uri_, pr_, /*timeout_ms=*/1500);
-  std::cout << "[CameraStream CTR] Stream " << uri_
-            << " probed: " << (pr_.probed ? "yes" : "no")
-            << ", has audio: " << (pr_.has_audio ? "yes" : "no") << std::endl;
+  feature_redetect_interval_ = settings.feature_redetect_interval();
+  feature_min_survivor_ratio_ = settings.feature_min_survivor_ratio();
+  diff_gate_ratio_ = settings.diff_gate_ratio();
+  diff_gate_pixel_threshold_ = settings.diff_gate_pixel_threshold();
+  motion_engine_ = motionEngineFromString(settings.motion_engine());
 
   std::string base_dir = core::PathUtils::getExecutableDir();
   std::string safe_name = core::PathUtils::sanitizeCameraName(name);
@@ -55,12 +82,44 @@ CameraStream::CameraStream(
   // segment_path = segment_dir + "segment-%03d.mp4";
   segment_path = segment_dir + "segment-%03d.mkv";
 
-  segmentWorker_ = std::make_unique<SegmentWorker>(segment_dir, 500);
+  segmentWorker_ = std::make_unique<SegmentWorker>(segment_dir);
 }
 
 CameraStream::~CameraStream() { stop(); }
 
 void CameraStream::start() {
+  if (supervisor_ && !std::atomic_load(&supervised_))
+    std::atomic_store(&supervised_,
+                      supervisor_->addStream(
+                          name_, [this] { return restartPipeline(); }));
+
+  std::lock_guard<std::mutex> lk(pipeline_mutex_);
+  startPipeline();
+}
+
+void CameraStream::stop() {
+  // Waits out a reconnect in progress; none is started after this
+  SupervisedStreamHandle supervised = std::atomic_load(&supervised_);
+  if (supervisor_ && supervised)
+    supervisor_->removeStream(supervised);
+
+  {
+    std::lock_guard<std::mutex> lk(pipeline_mutex_);
+    stopPipeline();
+  }
+  // Pipeline is gone, so is its buffer probe. Atomic: HTTP threads read
+  // the handle for stats and state.
+  std::atomic_store(&supervised_, SupervisedStreamHandle());
+}
+
+bool CameraStream::restartPipeline() {
+  std::lock_guard<std::mutex> lk(pipeline_mutex_);
+  stopPipeline();
+  startPipeline();
+  return pipeline_ && !start_failed_;
+}
+
+void CameraStream::startPipeline() {
   if (running_)
     return;
 
@@ -85,12 +144,107 @@ void CameraStream::start() {
       g_error_free(error);
 
     running_ = false;
+    start_failed_ = true;
     return;
   }
+  start_failed_ = false;
+
+  // Recreate segmentWorker if needed before starting
+  if (segment_ && !segmentWorker_) {
+    std::string base_dir = core::PathUtils::getExecutableDir();
+    std::string safe_name = core::PathUtils::sanitizeCameraName(name_);
+    std::string segment_dir = base_dir + "/media/" + safe_name + "/tmp/";
+    segmentWorker_ = std::make_unique<SegmentWorker>(segment_dir);
+  }
+
+  // Splitmuxsink fragment boundaries are handled straight from the posting
+  // thread. Errors and EOS go on to the runtime's main context, so one
+  // thread serves every camera's bus; everything else is dropped.
+  GstBus *bus = gst_element_get_bus(static_cast<GstElement *>(pipeline_));
+  gst_bus_set_sync_handler(bus, &CameraStream::onBusMessage, this, nullptr);
+  if (gst_runtime_)
+    bus_watch_ = gst_runtime_->addBusWatch(
+        bus, name_, [this](GstMessage *msg) { handleBusFailure(msg); });
+  gst_object_unref(bus);
+
+  // Every video buffer resets the supervisor's stall timer
+  if (SupervisedStreamHandle supervised = std::atomic_load(&supervised_)) {
+    if (GstElement *vt = gst_bin_get_by_name(GST_BIN(pipeline_), "vt")) {
+      if (GstPad *pad = gst_element_get_static_pad(vt, "sink")) {
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+                          &CameraStream::onVideoBuffer, supervised.get(),
+                          nullptr);
+        gst_object_unref(pad);
+      }
+      gst_object_unref(vt);
+    }
+  }
+
+  if (segment_) {
+    segmentWorker_->start();
+
+    // Record-on-motion-only: park the branch until the motion loop opens it
+    if (segment_on_motion_) {
+      GstElement *vq = gst_bin_get_by_name(GST_BIN(pipeline_), "seg_vgate");
+      GstElement *aq = gst_bin_get_by_name(GST_BIN(pipeline_), "seg_agate");
+      segment_gate_ = std::make_unique<SegmentGate>(name_);
+      if (!segment_gate_->attach(vq, aq))
+        segment_gate_.reset(); // Falls back to continuous segments
+      if (vq)
+        gst_object_unref(vq);
+      if (aq)
+        gst_object_unref(aq);
+    }
+  }
 
-  gst_element_set_state(static_cast<GstElement *>(pipeline_),
-                        GST_STATE_PLAYING);
+  if (preroll_recording_) {
+    int max_mb = std::max(1, settings_.preroll_max_mb());
+    preroll_ = std::make_unique<PrerollRecorder>(
+        name_, settings_.preroll_seconds(),
+        static_cast<size_t>(max_mb) * 1024 * 1024);
+    if (retention_) {
+      RetentionManager *retention = retention_;
+      preroll_->setOnClipWritten(
+          [retention](const std::string &path) { retention->add(path); });
+    }
+    preroll_->start();
+
+    preroll_sink_ = gst_bin_get_by_name(GST_BIN(pipeline_), "preroll_sink");
+    if (preroll_sink_) {
+      GstAppSinkCallbacks callbacks = {};
+      callbacks.new_sample = &CameraStream::onPrerollSample;
+      gst_app_sink_set_callbacks(GST_APP_SINK(preroll_sink_), &callbacks, this,
+                                 nullptr);
+    } else {
+      std::cerr << "appsink 'preroll_sink' not found in pipeline!"
+                << std::endl;
+    }
+  }
+
+  if (recording_) {
+    recorder_ = std::make_unique<ContinuousRecorder>(
+        name_, recordingRoot(), settings_.record_segment_seconds());
+    if (retention_) {
+      RetentionManager *retention = retention_;
+      recorder_->setOnFileClosed(
+          [retention](const std::filesystem::path &path) {
+            retention->add(path);
+          });
+    }
+
+    record_sink_ = gst_bin_get_by_name(GST_BIN(pipeline_), "record_sink");
+    if (record_sink_) {
+      GstAppSinkCallbacks callbacks = {};
+      callbacks.new_sample = &CameraStream::onRecordSample;
+      gst_app_sink_set_callbacks(GST_APP_SINK(record_sink_), &callbacks, this,
+                                 nullptr);
+    } else {
+      std::cerr << "appsink 'record_sink' not found in pipeline!" << std::endl;
+    }
+  }
 
+  // Hook up the motion sink before PLAYING so the first frame is delivered
+  // to a fully set up camera (segment worker included)
   if (motion_frame_) {
     motion_sink_ = gst_bin_get_by_name(GST_BIN(pipeline_), "motion_sink");
     // Optionally check for null and log error if not found
@@ -98,40 +252,78 @@ void CameraStream::start() {
       std::cerr << "appsink 'motion_sink' not found in pipeline!" << std::endl;
     }
 
+    // Motion vector engine: drop at GOP granularity only
+    motion_unit_resync_ = false;
+    if (GstElement *q = gst_bin_get_by_name(GST_BIN(pipeline_), "motion_mvq")) {
+      if (GstPad *pad = gst_element_get_static_pad(q, "sink")) {
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+                          &CameraStream::onMotionUnit, this, nullptr);
+        gst_object_unref(pad);
+      }
+      gst_object_unref(q);
+    }
+
+    if (motion_decode_mode_ == MotionDecodeMode::NonReference) {
+      if (GstElement *dec =
+              gst_bin_get_by_name(GST_BIN(pipeline_), "motion_dec")) {
+        if (GstPad *pad = gst_element_get_static_pad(dec, "sink")) {
+          gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+                            &CameraStream::onMotionNonRefUnit, nullptr,
+                            nullptr);
+          gst_object_unref(pad);
+        }
+        gst_object_unref(dec);
+      }
+    }
+
     startMotionLoop();
   }
 
-  // Recreate segmentWorker if needed before starting
-  if (segment_ && !segmentWorker_) {
-    std::string base_dir = core::PathUtils::getExecutableDir();
-    std::string safe_name = core::PathUtils::sanitizeCameraName(name_);
-    std::string segment_dir = base_dir + "/media/" + safe_name + "/tmp/";
-    segmentWorker_ = std::make_unique<SegmentWorker>(segment_dir, 500);
+  if (gst_element_set_state(static_cast<GstElement *>(pipeline_),
+                            GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    std::cerr << "[CameraStream] " << name_ << ": pipeline failed to start"
+              << std::endl;
+    start_failed_ = true;
   }
 
-  if (segment_)
-    segmentWorker_->start();
-
   running_ = true;
 }
 
-void CameraStream::stop() {
+void CameraStream::stopPipeline() {
   running_ = false; // Signal the motion loop to exit
-  motion_running_ = false;
-
-  // Join the thread if running
-  if (motion_thread_.joinable())
-    motion_thread_.join();
+  stopMotionLoop();
 
   if (pipeline_) {
     gst_element_set_state(static_cast<GstElement *>(pipeline_), GST_STATE_NULL);
+    if (bus_watch_) {
+      gst_runtime_->remove(bus_watch_); // Waits out a message in progress
+      bus_watch_ = nullptr;
+    }
     gst_object_unref(static_cast<GstElement *>(pipeline_));
     pipeline_ = nullptr;
   }
+  motion_stream_.reset(); // Pipeline is down, no more appsink callbacks
+  segment_gate_.reset();  // Pads are inactive, probes can go
   if (motion_sink_) {
     gst_object_unref(motion_sink_);
     motion_sink_ = nullptr;
   }
+  if (preroll_sink_) {
+    gst_object_unref(preroll_sink_);
+    preroll_sink_ = nullptr;
+  }
+  if (preroll_) {
+    preroll_->stop(); // Finalizes a clip still being written
+    preroll_.reset();
+  }
+  if (record_sink_) {
+    gst_object_unref(record_sink_);
+    record_sink_ = nullptr;
+  }
+  if (recorder_) {
+    recorder_->stop(); // Flushes the file and its index
+    recorder_.reset();
+  }
 
   if (segmentWorker_) {
     segmentWorker_->stop();
@@ -152,21 +344,54 @@ void CameraStream::disableSegmentRecording() {
   rebuild();
 }
 
-void CameraStream::enableFullRecording(const std::string &filename) {
-  if (recording_ && recordFile_ == filename)
+void CameraStream::enableFullRecording() {
+  if (recording_)
     return;
   recording_ = true;
-  recordFile_ = filename;
   rebuild();
 }
 void CameraStream::disableFullRecording() {
   if (!recording_)
     return;
   recording_ = false;
-  recordFile_.clear();
   rebuild();
 }
 
+std::filesystem::path CameraStream::recordingRoot() const {
+  return std::filesystem::path(output_path_) / "continuous";
+}
+
+RecordingStats CameraStream::recordingStats() const {
+  return recorder_ ? recorder_->stats() : RecordingStats{};
+}
+
+SupervisedStreamStats CameraStream::supervisorStats() const {
+  return supervisor_ ? supervisor_->stats(std::atomic_load(&supervised_))
+                     : SupervisedStreamStats{};
+}
+
+const char *CameraStream::state() const {
+  if (supervisor_ && supervisorStats().down)
+    return "reconnecting";
+
+  // start/stop/restart swap pipeline_ under this lock; one that is busy
+  // means a (re)start is in progress, so don't wait for it
+  std::unique_lock<std::mutex> lk(pipeline_mutex_, std::try_to_lock);
+  if (!lk.owns_lock())
+    return "starting";
+  if (!pipeline_)
+    return start_failed_ ? "failed" : "stopped";
+
+  // Zero timeout: reports the last completed transition; live RTSP sources
+  // stay in an async change until the camera answers
+  GstState current = GST_STATE_VOID_PENDING;
+  GstStateChangeReturn ret = gst_element_get_state(
+      static_cast<GstElement *>(pipeline_), &current, nullptr, 0);
+  if (start_failed_ || ret == GST_STATE_CHANGE_FAILURE)
+    return "failed";
+  return current == GST_STATE_PLAYING ? "running" : "starting";
+}
+
 void CameraStream::enableTimestampOverlay() {
   if (overlay_)
     return;
@@ -197,11 +422,71 @@ void CameraStream::disableMotionFrameSaving() {
   rebuild();
 }
 
+void CameraStream::enablePrerollRecording() {
+  if (preroll_recording_)
+    return;
+  preroll_recording_ = true;
+  rebuild();
+}
+void CameraStream::disablePrerollRecording() {
+  if (!preroll_recording_)
+    return;
+  preroll_recording_ = false;
+  rebuild();
+}
+
+void CameraStream::enableSegmentOnMotion() {
+  if (segment_on_motion_)
+    return;
+  segment_on_motion_ = true;
+  if (segment_)
+    rebuild();
+}
+void CameraStream::disableSegmentOnMotion() {
+  if (!segment_on_motion_)
+    return;
+  segment_on_motion_ = false;
+  if (segment_)
+    rebuild();
+}
+
+PrerollStats CameraStream::prerollStats() const {
+  return preroll_ ? preroll_->stats() : PrerollStats{};
+}
+
 void CameraStream::rebuild() {
+  std::lock_guard<std::mutex> lk(pipeline_mutex_);
   bool was_running = running_;
-  stop();
+  stopPipeline();
   if (was_running)
-    start();
+    startPipeline();
+}
+
+void CameraStream::setMotionFps(int fps) {
+  if (motion_fps_ == fps)
+    return;
+  motion_fps_ = fps;
+  // The rate cap lives in the pipeline; only rebuild if motion is running
+  if (motion_frame_)
+    rebuild();
+}
+
+void CameraStream::setMotionEngine(MotionEngine engine) {
+  const MotionEngine old = motion_engine_.exchange(engine);
+  // Only the motion vector engine changes the branch: it takes encoded
+  // H.264, the others decoded frames
+  const bool vectorsBefore = old == MotionEngine::MotionVectors;
+  const bool vectorsNow = engine == MotionEngine::MotionVectors;
+  if (vectorsBefore != vectorsNow && motion_frame_)
+    rebuild();
+}
+
+void CameraStream::setMotionDecodeMode(MotionDecodeMode mode) {
+  if (motion_decode_mode_ == mode)
+    return;
+  motion_decode_mode_ = mode;
+  if (motion_frame_)
+    rebuild();
 }
 
 std::string CameraStream::getMountPoint() const { return mount_point_; }
@@ -233,19 +518,25 @@ std::string CameraStream::buildPipelineWithoutAudio() const {
        "! h264parse config-interval=1 ! tee name=vt ";
 
   // 3a) Optional motion frames (decoded)
-  if (motion_frame_) {
-    p += "vt. ! queue ! avdec_h264 ! videoconvert ! videoscale "
-         "! video/x-raw,format=BGR "
-         "! appsink name=motion_sink emit-signals=false max-buffers=1 "
-         "drop=true sync=false ";
-  }
+  if (motion_frame_)
+    p += buildMotionBranch();
 
   // 3b) Encoded video to mux (only if segmenting)
   if (segment_) {
+    p += "vt. ! " + segmentQueue("seg_vgate") +
+         "! video/x-h264,stream-format=avc,alignment=au ! smux.video ";
+  }
+
+  // 3c) Encoded video to the in-memory pre-roll (motion clips)
+  if (preroll_recording_) {
     p += "vt. ! queue ! video/x-h264,stream-format=avc,alignment=au "
-         "! smux.video ";
+         "! appsink name=preroll_sink emit-signals=false sync=false ";
   }
 
+  // 3d) Continuous recording
+  if (recording_)
+    p += buildRecordBranch();
+
   return p;
 }
 
@@ -275,444 +566,986 @@ std::string CameraStream::buildPipelineWithAudio() const {
        "! h264parse config-interval=1 ! tee name=vt ";
 
   // 3a) Motion frames (decoded) — optional
-  if (motion_frame_) {
-    p += "vt. ! queue ! avdec_h264 ! videoconvert ! videoscale "
-         "! video/x-raw,format=BGR "
-         "! appsink name=motion_sink emit-signals=false max-buffers=1 "
-         "drop=true sync=false ";
-  }
+  if (motion_frame_)
+    p += buildMotionBranch();
 
   // 3b) Encoded video to mux (only if segmenting)
   if (segment_) {
+    p += "vt. ! " + segmentQueue("seg_vgate") +
+         "! video/x-h264,stream-format=avc,alignment=au ! smux.video ";
+  }
+
+  // 3c) Encoded video to the in-memory pre-roll (motion clips)
+  if (preroll_recording_) {
     p += "vt. ! queue ! video/x-h264,stream-format=avc,alignment=au "
-         "! smux.video ";
+         "! appsink name=preroll_sink emit-signals=false sync=false ";
   }
 
-  // 4) AUDIO: depay -> parse -> caps -> mux (only if segmenting)
-  if (segment_) {
+  // 3d) Continuous recording
+  if (recording_)
+    p += buildRecordBranch();
+
+  // 4) AUDIO: depay -> parse -> caps -> tee to the muxers that want it
+  if (segment_ || recording_) {
     p += "src. ! queue ! rtpmp4gdepay ! aacparse "
          "! audio/mpeg,mpegversion=4,stream-format=raw,rate=48000,channels=2 "
-         "! queue ! smux.audio_0 ";
+         "! tee name=at ";
+    if (segment_)
+      p += "at. ! " + segmentQueue("seg_agate") + "! smux.audio_0 ";
+    if (recording_)
+      p += "at. ! queue ! rtmux. ";
   }
 
   return p;
 }
 
+std::string CameraStream::buildRecordBranch() const {
+  // MPEG-TS so any keyframe offset in the index is a valid starting point;
+  // the second h264parse converts to byte-stream without touching the tee's
+  // caps. The recorder writes from the appsink thread.
+  return "vt. ! queue ! h264parse "
+         "! video/x-h264,stream-format=byte-stream,alignment=au "
+         "! mpegtsmux name=rtmux alignment=7 "
+         "! appsink name=record_sink emit-signals=false sync=false ";
+}
+
+std::string CameraStream::segmentQueue(const std::string &name) const {
+  if (!segment_on_motion_)
+    return "queue ";
+
+  // Gated branch: the queue is the pre-roll. It leaks its oldest buffers
+  // while SegmentGate holds its source pad, so upstream never stalls.
+  uint64_t window_ns =
+      static_cast<uint64_t>(std::max(1, settings_.preroll_seconds())) *
+      1000000000ULL;
+  uint64_t max_bytes =
+      static_cast<uint64_t>(std::max(1, settings_.preroll_max_mb())) * 1024 *
+      1024;
+  return "queue name=" + name +
+         " leaky=downstream max-size-buffers=0 max-size-bytes=" +
+         std::to_string(max_bytes) +
+         " max-size-time=" + std::to_string(window_ns) + " ";
+}
+
+void CameraStream::requestSegmentSplit() {
+  GstElement *smux = gst_bin_get_by_name(GST_BIN(pipeline_), "smux");
+  if (!smux)
+    return;
+  // Takes effect at the next keyframe
+  g_signal_emit_by_name(smux, "split-now");
+  gst_object_unref(smux);
+}
+
+cv::Size CameraStream::motionAnalysisSize() const {
+  // Without an explicit size we don't know the source resolution up front
+  if (motion_frame_size_.width <= 0 || motion_frame_size_.height <= 0)
+    return cv::Size(0, 0);
+
+  float scale = motion_frame_scale_ > 0.0f ? motion_frame_scale_ : 1.0f;
+  // Keep dimensions even so downstream YUV conversion stays exact
+  int w = std::max(2, static_cast<int>(motion_frame_size_.width * scale) & ~1);
+  int h = std::max(2, static_cast<int>(motion_frame_size_.height * scale) & ~1);
+  return cv::Size(w, h);
+}
+
+std::string CameraStream::buildMotionBranch() const {
+  // Rate-limit and scale in the streaming thread, so the motion loop
+  // receives frames that are ready for analysis. videorate sits right after
+  // the decoder so dropped frames are never scaled. Planar YUV is accepted
+  // as-is: the decoder's I420/NV12 passes videoconvert untouched and the
+  // motion loop reads the Y plane in place.
+  // Motion vector engine: the motion loop decodes the H.264 itself to get
+  // at the vectors, so every access unit goes through (no videorate, no
+  // decode mode). A unit lost inside a GOP would corrupt every frame up to
+  // the next keyframe, so the appsink blocks instead of dropping, and
+  // onMotionUnit() drops whole GOPs ahead of motion_mvq when the worker
+  // falls behind. SPS/PPS are repeated so decoding resumes at any keyframe.
+  if (motion_engine_.load() == MotionEngine::MotionVectors)
+    return "vt. ! queue ! h264parse config-interval=-1 "
+           "! video/x-h264,stream-format=byte-stream,alignment=au "
+           "! queue name=motion_mvq max-size-buffers=" +
+           std::to_string(kMotionUnitQueue) +
+           " max-size-bytes=0 max-size-time=0 "
+           "! appsink name=motion_sink emit-signals=false max-buffers=1 "
+           "drop=false sync=false ";
+
+  std::string p = "vt. ! queue ";
+
+  // Dropping before the decoder is what actually saves decode cost: only
+  // IDR/keyframes (no DELTA_UNIT flag) reach avdec_h264 in keyframe mode.
+  if (motion_decode_mode_ == MotionDecodeMode::KeyframesOnly)
+    p += "! identity drop-buffer-flags=delta-unit ";
+
+  // Non-reference mode: onMotionNonRefUnit() drops access units no other
+  // frame predicts from. That needs whole units in Annex B, which the tee
+  // does not guarantee. (avdec_h264 skip-frame=1 is documented as
+  // skipping B-frames, not non-reference frames.)
+  if (motion_decode_mode_ == MotionDecodeMode::NonReference)
+    p += "! h264parse "
+         "! video/x-h264,stream-format=byte-stream,alignment=au ";
+
+  p += "! avdec_h264 name=motion_dec ";
+
+  if (motion_fps_ > 0)
+    p += "! videorate drop-only=true max-rate=" + std::to_string(motion_fps_) +
+         " ";
+
+  p += "! videoscale ! videoconvert "
+       "! video/x-raw,format={I420,NV12,GRAY8}";
+
+  cv::Size sz = motionAnalysisSize();
+  if (sz.width > 0 && sz.height > 0)
+    p += ",width=" + std::to_string(sz.width) +
+         ",height=" + std::to_string(sz.height);
+
+  p += " ! appsink name=motion_sink emit-signals=false max-buffers=1 "
+       "drop=true sync=false ";
+  return p;
+}
+
 void CameraStream::startMotionLoop() {
   motion_running_ = true;
+  motion_state_ = MotionLoopState{};
+  MatAllocationCounter::install(); // For the Mat-allocations-per-frame stat
 
   std::cout << "Initiate motion-loop, scale: " << motion_frame_scale_
+            << ", fps: " << motion_fps_
+            << ", decode: " << motionDecodeModeToString(motion_decode_mode_)
             << ", segment: " << segment_ << std::endl;
 
-  motion_thread_ = std::thread([this] {
-    // Some vars outside actual loop
-    cv::Mat prevGray;
-    int motionHitCount = 0;
-    std::chrono::seconds motion_hold_duration(motion_hold_duration_);
+  if (!motion_sink_)
+    return;
 
-    while (motion_running_) {
-      GstSample *sample = nullptr;
-      bool segment_enabled = segment_.load(); // Copy once per iteration
+  if (motion_scheduler_) {
+    // Shared pool: the appsink tells the scheduler when a frame is ready and
+    // a pool worker drains it. No thread of our own.
+    motion_stream_ = motion_scheduler_->addStream(
+        name_, [this] { drainMotionSamples(); });
 
-      if (motion_sink_)
-        sample = gst_app_sink_pull_sample(GST_APP_SINK(motion_sink_));
+    GstAppSinkCallbacks callbacks = {};
+    callbacks.new_sample = &CameraStream::onMotionSample;
+    gst_app_sink_set_callbacks(GST_APP_SINK(motion_sink_), &callbacks, this,
+                               nullptr);
+    return;
+  }
 
-      if (!sample) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  // Standalone fallback: dedicated thread blocking on the appsink
+  motion_thread_ = std::thread([this] {
+    while (motion_running_) {
+      GstSample *sample = gst_app_sink_try_pull_sample(
+          GST_APP_SINK(motion_sink_), 100 * GST_MSECOND);
+      if (!sample)
         continue;
-      }
+      processMotionSample(sample);
+      gst_sample_unref(sample);
+    }
+    std::cout << "Left motion-loop" << std::endl;
+  });
+}
 
-      GstBuffer *buffer = gst_sample_get_buffer(sample);
-      GstCaps *caps = gst_sample_get_caps(sample);
+void CameraStream::stopMotionLoop() {
+  motion_running_ = false;
 
-      GstMapInfo map;
-      if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
-        gst_sample_unref(sample);
-        continue;
-      }
+  // Join the thread if running
+  if (motion_thread_.joinable())
+    motion_thread_.join();
 
-      // Extract frame dimensions and format from caps
-      int width = 0, height = 0;
-      const GstStructure *caps_struct = gst_caps_get_structure(caps, 0);
-      gst_structure_get_int(caps_struct, "width", &width);
-      gst_structure_get_int(caps_struct, "height", &height);
-      const gchar *format = gst_structure_get_string(caps_struct, "format");
-
-      cv::Mat mat;
-      if (format) {
-        if (strcmp(format, "BGR") == 0) {
-          mat = cv::Mat(height, width, CV_8UC3, (char *)map.data,
-                        cv::Mat::AUTO_STEP);
-        } else if (strcmp(format, "RGB") == 0) {
-          mat = cv::Mat(height, width, CV_8UC3, (char *)map.data,
-                        cv::Mat::AUTO_STEP);
-          cv::cvtColor(mat, mat, cv::COLOR_RGB2BGR);
-        } else if (strcmp(format, "I420") == 0) {
-          // I420 = YUV420p, width x height, 1.5 bytes per pixel
-          cv::Mat yuv(height + height / 2, width, CV_8UC1, (char *)map.data);
-          cv::Mat bgr;
-          cv::cvtColor(yuv, bgr, cv::COLOR_YUV2BGR_I420);
-          mat = bgr;
-        } else {
-          // Handle other formats as needed
-          std::cerr << "Unsupported pixel format for motion detection: "
-                    << format << std::endl;
-          gst_buffer_unmap(buffer, &map);
-          gst_sample_unref(sample);
-          continue;
-        }
+  // Waits for an in-flight drain on a pool worker to finish
+  if (motion_stream_ && motion_scheduler_)
+    motion_scheduler_->removeStream(motion_stream_);
 
-        // At this point, 'mat' is a valid OpenCV BGR image!
-        // === RUN MOTION DETECTION HERE ===
-        // For demo: save as JPEG (comment this out in real loop!)
-        // cv::imwrite("/tmp/motion.jpg", mat);
+  // Hand held buffers back to the decoder's pool before it goes away
+  for (auto &held : motion_state_.held)
+    held.release();
+  motion_state_.prevGray.release();
+}
 
-        // Optionally: store the last frame (as a member variable)
-        // last_motion_frame_ = mat.clone();
+void CameraStream::MotionLoopState::HeldFrame::release() {
+  if (!mapped)
+    return;
+  gst_video_frame_unmap(&frame); // Drops the buffer ref taken by map
+  mapped = false;
+}
 
-        // --- MOTION ANALYSIS LOGIC ---
-        cv::Mat resized = mat;
-        // Step 1: Resize to explicit dimensions if set
-        if (motion_frame_size_.width > 0 && motion_frame_size_.height > 0) {
-          cv::resize(mat, resized, motion_frame_size_, 0, 0, cv::INTER_LINEAR);
-        }
+GstFlowReturn CameraStream::onMotionSample(GstAppSink * /*sink*/,
+                                           gpointer user_data) {
+  auto *self = static_cast<CameraStream *>(user_data);
+  if (self->motion_stream_)
+    self->motion_scheduler_->notify(self->motion_stream_);
+  return GST_FLOW_OK;
+}
 
-        // Step 2: Apply scale if < 1.0 (or any value != 1.0)
-        if (motion_frame_scale_ > 0.0f && motion_frame_scale_ != 1.0f) {
-          cv::Mat scaled;
-          cv::resize(resized, scaled, cv::Size(), motion_frame_scale_,
-                     motion_frame_scale_, cv::INTER_LINEAR);
-          resized = scaled; // overwrite
-        }
+GstBusSyncReply CameraStream::onBusMessage(GstBus * /*bus*/, GstMessage *msg,
+                                           gpointer user_data) {
+  auto *self = static_cast<CameraStream *>(user_data);
+
+  switch (GST_MESSAGE_TYPE(msg)) {
+  case GST_MESSAGE_ERROR:
+  case GST_MESSAGE_EOS:
+    if (self->bus_watch_)
+      return GST_BUS_PASS; // To handleBusFailure() on the runtime thread
+    self->handleBusFailure(msg);
+    break;
+  case GST_MESSAGE_ELEMENT: {
+    const GstStructure *st = gst_message_get_structure(msg);
+    if (!st)
+      break;
+    bool opened = gst_structure_has_name(st, "splitmuxsink-fragment-opened");
+    bool closed = gst_structure_has_name(st, "splitmuxsink-fragment-closed");
+    if (!opened && !closed)
+      break;
+
+    const gchar *location = gst_structure_get_string(st, "location");
+    guint64 running_time = 0;
+    gst_structure_get_uint64(st, "running-time", &running_time);
+
+    if (location && self->segmentWorker_) {
+      if (opened)
+        self->segmentWorker_->onFragmentOpened(location, running_time);
+      else
+        self->segmentWorker_->onFragmentClosed(location, running_time);
+    }
+    break;
+  }
+  default:
+    break;
+  }
 
-        cv::Mat gray;
-        cv::cvtColor(resized, gray, cv::COLOR_BGR2GRAY);
-
-        // Only analyze motion if previous gray exists (skip on very first
-        // frame)
-        if (!prevGray.empty()) {
-          std::vector<cv::Point2f> prevPts, nextPts;
-          // Find good features to track in previous gray frame
-          cv::goodFeaturesToTrack(prevGray, prevPts, 100, 0.01, 10);
-
-          if (!prevPts.empty()) {
-            std::vector<uchar> status;
-            std::vector<float> err;
-            // Calculate optical flow between previous and current gray frames
-            cv::calcOpticalFlowPyrLK(prevGray, gray, prevPts, nextPts, status,
-                                     err);
-
-            float totalMotion = 0;
-            int validCount = 0;
-            cv::Mat vis = resized.clone();
-
-            // Draw motion regions on visualization
-            for (const auto &region : motion_regions_) {
-              if (region.angle == 0.0f) {
-                // Draw regular rectangle for non-rotated regions
-                cv::rectangle(vis, region.rect, cv::Scalar(255, 0, 0), 2);
-              } else {
-                // Draw rotated rectangle
-                cv::RotatedRect rotRect = region.getRotatedRect();
-                cv::Point2f vertices[4];
-                rotRect.points(vertices);
-                for (int i = 0; i < 4; i++) {
-                  cv::line(vis, vertices[i], vertices[(i + 1) % 4],
-                           cv::Scalar(255, 0, 0), 2);
-                }
-              }
-              cv::putText(vis, "Region " + std::to_string(region.id),
-                          cv::Point(region.rect.x, region.rect.y - 10),
-                          cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 0, 0),
-                          1);
-            }
-
-            for (size_t i = 0; i < prevPts.size(); ++i) {
-              if (status[i]) {
-                // Check if point is within any motion region (if regions are
-                // defined)
-                bool pointInRegion =
-                    motion_regions_
-                        .empty(); // If no regions, analyze entire frame
-
-                if (!motion_regions_.empty()) {
-                  for (const auto &region : motion_regions_) {
-                    if (region.angle == 0.0f) {
-                      // Use simple rectangle containment for non-rotated
-                      // regions
-                      if (region.rect.contains(cv::Point2i(prevPts[i]))) {
-                        pointInRegion = true;
-                        break;
-                      }
-                    } else {
-                      // Use rotated rectangle containment
-                      cv::RotatedRect rotRect = region.getRotatedRect();
-                      std::vector<cv::Point2f> vertices(4);
-                      rotRect.points(vertices.data());
-
-                      // Check if point is inside the rotated rectangle using
-                      // pointPolygonTest
-                      if (cv::pointPolygonTest(vertices, prevPts[i], false) >=
-                          0) {
-                        pointInRegion = true;
-                        break;
-                      }
-                    }
-                  }
-                }
-
-                if (pointInRegion) {
-                  float dist = cv::norm(nextPts[i] - prevPts[i]);
-                  if (dist > noise_threshold_) // Filter out some irrelevent
-                                               // dists (noise).
-                  {
-                    totalMotion += dist;
-                    validCount++;
-
-                    // Draw arrowed lines to show direction of motion
-                    cv::Point2f dir = nextPts[i] - prevPts[i];
-                    cv::Point2f scaledEnd =
-                        prevPts[i] + 5.0 * dir; // scale arrow for visibility
-                    cv::arrowedLine(vis, prevPts[i], scaledEnd,
-                                    cv::Scalar(0, 255, 0), 2);
-                  }
-                }
-              }
-            }
-
-            float avgMotion = 0;
-
-            // Calculate average motion score
-            if (validCount > 0) {
-              avgMotion = totalMotion / validCount;
-            }
-
-            // Always draw motion value on visualization
-            std::ostringstream oss;
-            oss << "Motion: " << avgMotion;
-            cv::putText(vis, oss.str(), cv::Point(10, 30),
-                        cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 255),
-                        2);
-
-            // Always update the motion frame to show current state
-            last_motion_frame_ = vis.clone();
-
-            // Check if motion exceeds threshold for detection logic
-            if (avgMotion > motion_threshold_) {
-              ++motionHitCount;
-              if (motionHitCount >= motion_min_hits_) {
-                std::cout << "[Motion] avg displacement: " << avgMotion
-                          << std::endl;
-                lastMotionTime_ = std::chrono::steady_clock::now();
-              }
-            } else {
-              // Decay hit count gently, don't zero immediately
-              if (motionHitCount > 0)
-                motionHitCount -= motion_decay_;
-            }
-
-            motionDetected_ =
-                std::chrono::steady_clock::now() - lastMotionTime_ <=
-                motion_hold_duration;
-
-            if (motionDetected_ != prevMotionDetected_)
-              std::cout << (motionDetected_ ? "[Motion] started."
-                                            : "[Motion] stopped.");
-
-            // This applies only if motion-record = on
-            if (segment_enabled) {
-
-              if (motionDetected_)
-                segmentWorker_->SaveCurrentSegment();
-
-              bool motionTransition = (!motionDetected_ && prevMotionDetected_);
-              if (motionTransition)
-                segmentWorker_->setState(
-                    SegmentWorker::WorkerState::
-                        FinishRequested); // Finish current segment for us
-
-              // We asked segmentworker to finish in previous tick, now theres
-              // new motion
-              if (segmentWorker_->getState() ==
-                      SegmentWorker::WorkerState::FinishRequested &&
-                  motionDetected_) {
-                std::cout << "[Motion] Segmentworker asked to finalize, but "
-                             "there was new motion!"
-                          << std::endl;
-                segmentWorker_->setState(
-                    SegmentWorker::WorkerState::Working); // Back to work! Not
-                // time to finialize
-                // video yet
-              }
-
-              if (segmentWorker_->getState() ==
-                  SegmentWorker::WorkerState::Finalized) // Or if we have to
-                                                         // many
-              // segments
-              // Export final output file !
-              {
-                std::cout << "[Motion] Time to finish video" << std::endl;
-
-                auto segments = segmentWorker_->getAndResetMotionSegments();
-
-                if (!segments.empty()) {
-                  std::string outputFilename = getTimestampedFilename(); // e.g.
-                  // motion-2025-07-29_21-15-43.mp4
-                  exportInBackground(segments, output_path_, outputFilename);
-                } else
-                  std::cout << "[Motion] No segments!!" << std::endl;
-
-                segmentWorker_->setState(SegmentWorker::WorkerState::Working);
-              }
-            }
-          }
-          prevMotionDetected_ = motionDetected_;
-        }
-        prevGray = gray.clone(); // Save for next loop
-      }
+  // Only errors and EOS are popped (by the runtime watch); drop the rest
+  gst_message_unref(msg);
+  return GST_BUS_DROP;
+}
 
-      gst_buffer_unmap(buffer, &map);
-      gst_sample_unref(sample);
-    }
-    std::cout << "Left motion-loop" << std::endl;
-  });
+void CameraStream::handleBusFailure(GstMessage *msg) {
+  std::string reason;
+  if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+    GError *err = nullptr;
+    gchar *debug = nullptr;
+    gst_message_parse_error(msg, &err, &debug);
+    reason = err ? err->message : "pipeline error";
+    if (err)
+      g_error_free(err);
+    g_free(debug);
+  } else if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS) {
+    reason = "end of stream";
+  } else {
+    return;
+  }
+  std::cerr << "[CameraStream] " << name_ << ": " << reason << std::endl;
+  if (supervisor_)
+    supervisor_->reportFailure(std::atomic_load(&supervised_), reason);
 }
 
-void CameraStream::exportInBackground(
-    const std::vector<std::filesystem::path> &segments,
-    const std::filesystem::path &outputFolder,
-    const std::string &outputFilename) {
-  std::thread([=]() {
-    bool ok =
-        VideoExporter::exportSegments(segments, outputFolder, outputFilename);
-    if (ok) {
-      std::cout << "[MotionLoop] Export completed: " << outputFilename
+GstPadProbeReturn CameraStream::onVideoBuffer(GstPad * /*pad*/,
+                                              GstPadProbeInfo * /*info*/,
+                                              gpointer user_data) {
+  StreamSupervisor::noteBuffer(*static_cast<SupervisedStream *>(user_data));
+  return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn CameraStream::onMotionUnit(GstPad *pad,
+                                             GstPadProbeInfo *info,
+                                             gpointer user_data) {
+  auto *self = static_cast<CameraStream *>(user_data);
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  const bool keyframe =
+      buf && !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  guint level = 0;
+  if (GstElement *queue = gst_pad_get_parent_element(pad)) {
+    g_object_get(queue, "current-level-buffers", &level, nullptr);
+    gst_object_unref(queue);
+  }
+
+  // About to fill up: the worker is behind. Drop from here to the next
+  // keyframe that finds room, so the decoder never misses a reference.
+  if (level + 1 >= kMotionUnitQueue) {
+    if (!self->motion_unit_resync_.exchange(true))
+      std::cerr << "[Motion] " << self->name_
+                << ": analysis behind, skipping to the next keyframe"
                 << std::endl;
+  } else if (keyframe) {
+    self->motion_unit_resync_ = false;
+  }
+
+  if (!self->motion_unit_resync_)
+    return GST_PAD_PROBE_OK;
+  self->engine_units_dropped_++;
+  return GST_PAD_PROBE_DROP;
+}
+
+// An access unit nothing else references: it has slices, and every one
+// of them has nal_ref_idc 0. Byte-stream (Annex B) input.
+GstPadProbeReturn CameraStream::onMotionNonRefUnit(GstPad * /*pad*/,
+                                                   GstPadProbeInfo *info,
+                                                   gpointer /*user_data*/) {
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  GstMapInfo map;
+  if (!buf || !gst_buffer_map(buf, &map, GST_MAP_READ))
+    return GST_PAD_PROBE_OK;
+
+  bool slices = false;
+  bool referenced = false;
+  for (gsize i = 0; i + 3 < map.size && !referenced; i++) {
+    if (map.data[i] != 0 || map.data[i + 1] != 0 || map.data[i + 2] != 1)
+      continue;
+    const guint8 header = map.data[i + 3];
+    const int type = header & 0x1f;
+    if (type >= 1 && type <= 5) { // Coded slice (IDR is 5)
+      slices = true;
+      referenced = (header >> 5) & 0x3;
+    }
+    i += 3;
+  }
+  gst_buffer_unmap(buf, &map);
+
+  return slices && !referenced ? GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+}
+
+GstFlowReturn CameraStream::onPrerollSample(GstAppSink *sink,
+                                            gpointer user_data) {
+  auto *self = static_cast<CameraStream *>(user_data);
+  GstSample *sample = gst_app_sink_pull_sample(sink);
+  if (!sample)
+    return GST_FLOW_OK;
+  if (self->preroll_)
+    self->preroll_->pushSample(sample); // Takes ownership
+  else
+    gst_sample_unref(sample);
+  return GST_FLOW_OK;
+}
+
+GstFlowReturn CameraStream::onRecordSample(GstAppSink *sink,
+                                           gpointer user_data) {
+  auto *self = static_cast<CameraStream *>(user_data);
+  GstSample *sample = gst_app_sink_pull_sample(sink);
+  if (!sample)
+    return GST_FLOW_OK;
+  if (self->recorder_)
+    self->recorder_->pushSample(sample); // Takes ownership
+  else
+    gst_sample_unref(sample);
+  return GST_FLOW_OK;
+}
+
+void CameraStream::drainMotionSamples() {
+  // Runs on a scheduler worker; never concurrently for the same camera
+  while (motion_running_) {
+    GstSample *sample =
+        gst_app_sink_try_pull_sample(GST_APP_SINK(motion_sink_), 0);
+    if (!sample)
+      break;
+    processMotionSample(sample);
+    gst_sample_unref(sample);
+  }
+}
+
+void CameraStream::processMotionSample(GstSample *sample) {
+  MotionLoopState &st = motion_state_;
+  bool segment_enabled = segment_.load(); // Copy once per frame
+  const uint64_t matAllocsBefore = MatAllocationCounter::thisThread();
+
+  GstBuffer *buffer = gst_sample_get_buffer(sample);
+  GstCaps *caps = gst_sample_get_caps(sample);
+  if (caps && gst_structure_has_name(gst_caps_get_structure(caps, 0),
+                                     "video/x-h264")) {
+    processEncodedMotionSample(sample);
+    return;
+  }
+  GstVideoInfo info;
+  if (!buffer || !caps || !gst_video_info_from_caps(&info, caps))
+    return;
+
+  // This slot last held the frame before prevGray, which nothing refers to
+  // any more. Mapping takes a buffer ref, so the pixels outlive the sample.
+  MotionLoopState::HeldFrame &held = st.held[st.cur];
+  held.release();
+  if (!gst_video_frame_map(&held.frame, &info, buffer, GST_MAP_READ))
+    return;
+  held.mapped = true;
+
+  const GstVideoFormat format = GST_VIDEO_INFO_FORMAT(&info);
+  const GstVideoFormatInfo *finfo = info.finfo;
+  const int width = GST_VIDEO_INFO_WIDTH(&info);
+  const int height = GST_VIDEO_INFO_HEIGHT(&info);
+  void *plane0 = GST_VIDEO_FRAME_PLANE_DATA(&held.frame, 0);
+  const size_t stride0 = GST_VIDEO_FRAME_PLANE_STRIDE(&held.frame, 0);
+
+  // An 8-bit plane 0 with one byte per pixel is the luma of planar YUV
+  // (I420, NV12, Y42B, ...) or the GRAY8 image itself: usable as gray
+  // without conversion. Strides come from the GstVideoMeta when present.
+  const bool lumaPlane =
+      format == GST_VIDEO_FORMAT_GRAY8 ||
+      (GST_VIDEO_FORMAT_INFO_IS_YUV(finfo) &&
+       GST_VIDEO_FORMAT_INFO_DEPTH(finfo, 0) == 8 &&
+       GST_VIDEO_FORMAT_INFO_PSTRIDE(finfo, 0) == 1);
+
+  // Views into the mapped frame; conversions land in reused buffers
+  cv::Mat mat;
+  if (lumaPlane) {
+    mat = cv::Mat(height, width, CV_8UC1, plane0, stride0);
+  } else if (format == GST_VIDEO_FORMAT_BGR) {
+    mat = cv::Mat(height, width, CV_8UC3, plane0, stride0);
+  } else if (format == GST_VIDEO_FORMAT_RGB) {
+    // Mapped read-only: convert into our own buffer, not in place
+    cv::Mat rgb(height, width, CV_8UC3, plane0, stride0);
+    cv::cvtColor(rgb, st.colorBuf, cv::COLOR_RGB2BGR);
+    mat = st.colorBuf;
+  } else {
+    std::cerr << "Unsupported pixel format for motion detection: "
+              << gst_video_format_to_string(format) << std::endl;
+    held.release();
+    return;
+  }
+
+  // --- MOTION ANALYSIS LOGIC ---
+  // The pipeline normally delivers frames at analysis size already.
+  // Only resize here when the pipeline couldn't (scale without an
+  // explicit size) or size/scale were changed at runtime.
+  cv::Size target = motionAnalysisSize();
+  if (target.width <= 0 && motion_frame_scale_ > 0.0f &&
+      motion_frame_scale_ != 1.0f) {
+    target = cv::Size(cvRound(mat.cols * motion_frame_scale_),
+                      cvRound(mat.rows * motion_frame_scale_));
+  }
+  const bool resize =
+      target.width > 0 && target.height > 0 && target != mat.size();
+
+  // 'gray' is this frame's half of the ping-pong pair: it becomes
+  // prevGray for the next frame without a copy. At analysis size it is
+  // the Y plane itself, kept mapped in held[cur] until the frame after
+  // next; otherwise it is grayBuf[cur]. 'color' is the BGR frame (empty
+  // for luma input), kept for visualization.
+  cv::Mat gray;
+  cv::Mat color;
+  const bool zeroCopy = lumaPlane && !resize;
+  if (zeroCopy) {
+    gray = mat;
+  } else if (mat.channels() == 1) {
+    cv::resize(mat, st.grayBuf[st.cur], target, 0, 0, cv::INTER_AREA);
+    gray = st.grayBuf[st.cur];
+  } else {
+    color = mat;
+    if (resize) {
+      cv::resize(mat, st.scaledBuf, target, 0, 0, cv::INTER_AREA);
+      color = st.scaledBuf;
+    }
+    cv::cvtColor(color, st.grayBuf[st.cur], cv::COLOR_BGR2GRAY);
+    gray = st.grayBuf[st.cur];
+  }
+  prepareMotionState(gray.size(), st);
+
+  // Nobody watching: skip everything that only feeds the overlay, and
+  // drop the last frame so a returning viewer never gets a stale one
+  const bool render = motionViewerActive();
+  if (!render && hasMotionSnapshot())
+    std::atomic_store(&motion_snapshot_,
+                      std::shared_ptr<const MotionSnapshot>());
+  auto overlayBase = [&] {
+    MotionOverlay overlay;
+    overlay.frame = color.empty() ? gray.clone() : color.clone();
+    overlay.regions = st.regions;
+    return overlay;
+  };
+
+  // Only analyze motion if previous gray exists (skip on very first
+  // frame)
+  bool analyzed = false;
+  if (!st.prevGray.empty()) {
+    // Stage 1: cheap frame difference against the last analyzed frame.
+    // Static scenes stop here and never reach the motion engine.
+    bool gated = false;
+    float gateRatio = diff_gate_ratio_.load();
+    if (gateRatio > 0.0f) {
+      downsampleForGate(gray, st.gateSmall);
+      float changed = changedPixelRatio(st.gateSmall, st.gateRef,
+                                        diff_gate_pixel_threshold_,
+                                        st.gateDiff);
+      gated = changed >= 0.0f && changed < gateRatio;
+    }
+
+    if (gated) {
+      frames_gated_++;
+
+      st.detector->skipped();
+      st.result.regionScore.assign(st.regionArea.size(), 0.0f);
+      st.result.regionPoints.assign(st.regionArea.size(), 0);
+      publishRegionScores(st);
+
+      if (render) {
+        MotionOverlay overlay = overlayBase();
+        overlay.gated = true;
+        publishMotionFrame(std::move(overlay));
+      }
+
+      updateMotionState(0.0f, st.motionHitCount, segment_enabled);
     } else {
-      std::cerr << "[MotionLoop] Export failed for " << outputFilename
-                << std::endl;
+      analyzed = true;
+      frames_analyzed_++;
+      if (gateRatio > 0.0f)
+        std::swap(st.gateRef, st.gateSmall);
+
+      // Stage 2: the selected engine scores the frame
+      const MotionDetectorInput in{gray,
+                                   st.prevGray,
+                                   st.regionMask,
+                                   st.regionArea,
+                                   noise_threshold_,
+                                   feature_redetect_interval_.load(),
+                                   feature_min_survivor_ratio_.load(),
+                                   render,
+                                   motion_threshold_};
+      scoreMotionFrame(st, in, color.empty() ? gray : color,
+                       segment_enabled);
     }
-  }).detach(); // No join, just fire-and-forget
+    prevMotionDetected_ = motionDetected_;
+  }
+  // Swap halves instead of cloning: the next frame writes the other one
+  st.prevGray = gray;
+  if (!zeroCopy)
+    held.release(); // Pixels were copied or converted out of the frame
+  st.cur ^= 1;
+
+  if (analyzed) {
+    const uint64_t matAllocs =
+        MatAllocationCounter::thisThread() - matAllocsBefore;
+    analyzed_mat_allocs_ += matAllocs;
+    last_frame_mat_allocs_ = matAllocs;
+  }
 }
 
-std::string CameraStream::getTimestampedFilename(const std::string &prefix,
-                                                 const std::string &ext) {
-  auto now = std::chrono::system_clock::now();
-  std::time_t now_c = std::chrono::system_clock::to_time_t(now);
+void CameraStream::processEncodedMotionSample(GstSample *sample) {
+  MotionLoopState &st = motion_state_;
+  bool segment_enabled = segment_.load(); // Copy once per frame
+  const uint64_t matAllocsBefore = MatAllocationCounter::thisThread();
 
-  std::tm tm;
-  localtime_r(&now_c, &tm); // Use localtime_s on Windows
+  // Engine switched away; the rebuilt pipeline will send decoded frames
+  if (motion_engine_.load() != MotionEngine::MotionVectors)
+    return;
 
-  std::ostringstream oss;
-  oss << prefix << std::put_time(&tm, "%Y-%m-%d_%H-%M-%S") << ext;
+  if (!st.mvDecoder)
+    st.mvDecoder = std::make_unique<MotionVectorDecoder>();
+  if (!st.mvDecoder->valid())
+    return;
 
-  return oss.str(); // e.g., motion-2025-07-29_21-15-43.mp4
+  GstBuffer *buffer = gst_sample_get_buffer(sample);
+  GstMapInfo map;
+  if (!buffer || !gst_buffer_map(buffer, &map, GST_MAP_READ))
+    return;
+  const GstClockTime pts = GST_BUFFER_PTS(buffer);
+  const bool decoded = st.mvDecoder->decode(
+      map.data, map.size,
+      GST_CLOCK_TIME_IS_VALID(pts) ? static_cast<int64_t>(pts) : 0);
+  gst_buffer_unmap(buffer, &map);
+  if (!decoded)
+    return;
+  const MotionVectorFrame &frame = st.mvDecoder->frame();
+  if (frame.width <= 0 || frame.height <= 0)
+    return;
+
+  // Vectors and regions live at analysis size, like the pixel engines'
+  const cv::Size frameSize(frame.width, frame.height);
+  cv::Size target = motionAnalysisSize();
+  if (target.width <= 0 && motion_frame_scale_ > 0.0f &&
+      motion_frame_scale_ != 1.0f) {
+    target = cv::Size(cvRound(frame.width * motion_frame_scale_),
+                      cvRound(frame.height * motion_frame_scale_));
+  }
+  if (target.width <= 0 || target.height <= 0)
+    target = frameSize;
+  prepareMotionState(target, st);
+
+  // Pixels are only needed for the fallback and the overlay. The decoder
+  // reuses its frame, so the luma is copied (or scaled) out.
+  const bool render = motionViewerActive();
+  if (!render && hasMotionSnapshot())
+    std::atomic_store(&motion_snapshot_,
+                      std::shared_ptr<const MotionSnapshot>());
+  const bool needPixels = render || settings_.mv_fallback_band() > 0.0f ||
+                          settings_.mv_fallback_intra_ratio() <= 1.0f;
+  cv::Mat gray;
+  if (needPixels && !frame.luma.empty()) {
+    cv::Mat &buf = st.grayBuf[st.cur];
+    if (target != frameSize)
+      cv::resize(frame.luma, buf, target, 0, 0, cv::INTER_AREA);
+    else
+      frame.luma.copyTo(buf);
+    gray = buf;
+  }
+
+  bool analyzed = false;
+  if (!frame.hasVectors) {
+    // Keyframe: nothing to compare, the motion state carries over
+    st.detector->skipped();
+  } else {
+    analyzed = true;
+    frames_analyzed_++;
+
+    const float sx = float(target.width) / frame.width;
+    const float sy = float(target.height) / frame.height;
+    st.blockVectors.clear();
+    for (const MotionVector &v : frame.vectors)
+      st.blockVectors.push_back({cv::Point2f(v.from.x * sx, v.from.y * sy),
+                                 cv::Point2f(v.to.x * sx, v.to.y * sy)});
+
+    const MotionDetectorInput in{gray,
+                                 st.prevGray,
+                                 st.regionMask,
+                                 st.regionArea,
+                                 noise_threshold_,
+                                 feature_redetect_interval_.load(),
+                                 feature_min_survivor_ratio_.load(),
+                                 render && !gray.empty(),
+                                 motion_threshold_,
+                                 &st.blockVectors,
+                                 frame.intraRatio};
+    scoreMotionFrame(st, in, gray, segment_enabled);
+    prevMotionDetected_ = motionDetected_;
+  }
+
+  st.prevGray = gray;
+  st.cur ^= 1;
+
+  if (analyzed) {
+    const uint64_t matAllocs =
+        MatAllocationCounter::thisThread() - matAllocsBefore;
+    analyzed_mat_allocs_ += matAllocs;
+    last_frame_mat_allocs_ = matAllocs;
+  }
 }
-struct Ctx {
-  std::mutex *m;
-  std::condition_variable *cv;
-  std::atomic<bool> *done;
-  AudioProbeResult *out;
-};
-
-static void on_pad_added(GstElement * /*src*/, GstPad *pad,
-                         gpointer user_data) {
-  auto *ctx = static_cast<Ctx *>(user_data);
-
-  // Prefer current caps; fall back to query
-  GstCaps *caps = gst_pad_get_current_caps(pad);
-  if (!caps)
-    caps = gst_pad_query_caps(pad, nullptr);
-  if (!caps)
-    return;
-
-  const GstStructure *s = gst_caps_get_structure(caps, 0);
-  const char *media = gst_structure_get_string(s, "media");
-  if (media && g_str_equal(media, "audio")) {
-    ctx->out->has_audio = true;
-    if (const char *enc = gst_structure_get_string(s, "encoding-name"))
-      ctx->out->encoding = enc;
-
-    int rate = 0, channels = 0;
-    gst_structure_get_int(s, "clock-rate", &rate); // RTP caps field
-    gst_structure_get_int(s, "channels", &channels);
-    if (rate)
-      ctx->out->rate = rate;
-    if (channels)
-      ctx->out->channels = channels;
-
-    {
-      std::lock_guard<std::mutex> lk(*ctx->m);
-      ctx->done->store(true);
-    }
-    ctx->cv->notify_one();
+
+void CameraStream::prepareMotionState(const cv::Size &frameSize,
+                                      MotionLoopState &st) {
+  // Engine switched at runtime: start the new one without history
+  const MotionEngine engine = motion_engine_.load();
+  if (!st.detector || st.detector->engine() != engine) {
+    st.detector = MotionDetector::create(engine, settings_);
+    engine_frames_ = 0;
+    engine_us_ = 0;
+    last_engine_us_ = 0;
+    engine_fallbacks_ = 0;
+    engine_units_dropped_ = 0;
+  }
+
+  // Frame size changed (scale/size updated at runtime): start over
+  if (!st.prevGray.empty() && st.prevGray.size() != frameSize) {
+    st.prevGray.release();
+    st.detector->reset();
+  }
+
+  // Rasterize the regions when they change or the frame resizes
+  unsigned regionsVersion = regions_version_.load();
+  if (st.regionMaskSize != frameSize ||
+      st.regionMaskVersion != regionsVersion) {
+    buildRegionMask(frameSize, st);
+    st.regionMaskSize = frameSize;
+    st.regionMaskVersion = regionsVersion;
+    st.detector->reset(); // Old points may lie outside new regions
   }
-  gst_caps_unref(caps);
 }
 
-static void on_no_more_pads(GstElement * /*src*/, gpointer user_data) {
-  auto *ctx = static_cast<Ctx *>(user_data);
-  {
-    std::lock_guard<std::mutex> lk(*ctx->m);
-    ctx->done->store(true);
+void CameraStream::scoreMotionFrame(MotionLoopState &st,
+                                    const MotionDetectorInput &in,
+                                    const cv::Mat &frame,
+                                    bool segment_enabled) {
+  const auto engineStart = std::chrono::steady_clock::now();
+  st.detector->analyze(in, st.result);
+  const uint64_t engineUs =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - engineStart)
+          .count();
+  engine_us_ += engineUs;
+  last_engine_us_ = engineUs;
+  engine_frames_++;
+  if (st.result.fallback)
+    engine_fallbacks_++;
+  publishRegionScores(st);
+
+  if (in.render) {
+    MotionOverlay overlay;
+    overlay.frame = frame.clone();
+    overlay.regions = st.regions;
+    overlay.vectors = st.result.vectors; // Engine keeps its capacity
+    if (!st.result.foreground.empty())
+      overlay.foreground = st.result.foreground.clone();
+    overlay.motion = st.result.motion;
+    publishMotionFrame(std::move(overlay));
   }
-  ctx->cv->notify_one();
+
+  updateMotionState(st.result.motion, st.motionHitCount, segment_enabled);
+}
+
+namespace {
+
+int64_t steadyNowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void drawMotionRegions(cv::Mat &vis,
+                       const std::vector<MotionRegion> &regions) {
+  for (const auto &region : regions) {
+    if (region.angle == 0.0f) {
+      // Draw regular rectangle for non-rotated regions
+      cv::rectangle(vis, region.rect, cv::Scalar(255, 0, 0), 2);
+    } else {
+      // Draw rotated rectangle
+      cv::RotatedRect rotRect = region.getRotatedRect();
+      cv::Point2f vertices[4];
+      rotRect.points(vertices);
+      for (int i = 0; i < 4; i++) {
+        cv::line(vis, vertices[i], vertices[(i + 1) % 4], cv::Scalar(255, 0, 0),
+                 2);
+      }
+    }
+    cv::putText(vis, "Region " + std::to_string(region.id),
+                cv::Point(region.rect.x, region.rect.y - 10),
+                cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 0, 0), 1);
+  }
+}
+
+} // namespace
+
+const cv::Mat &MotionSnapshot::frame() const {
+  std::call_once(frame_once_, [this] {
+    const MotionOverlay &o = overlay_;
+    if (o.frame.empty())
+      return;
+    if (o.frame.channels() == 1)
+      cv::cvtColor(o.frame, frame_, cv::COLOR_GRAY2BGR);
+    else
+      o.frame.copyTo(frame_);
+
+    if (o.foreground.size() == frame_.size()) {
+      // Moving pixels tinted red at half strength
+      cv::Mat tinted = frame_.clone();
+      tinted.setTo(cv::Scalar(0, 0, 255), o.foreground);
+      cv::addWeighted(tinted, 0.5, frame_, 0.5, 0.0, frame_);
+    }
+    drawMotionRegions(frame_, o.regions);
+    for (const MotionVector &v : o.vectors) {
+      // Arrow scaled up so small displacements stay visible
+      cv::Point2f scaledEnd = v.from + 5.0f * (v.to - v.from);
+      cv::arrowedLine(frame_, v.from, scaledEnd, cv::Scalar(0, 255, 0), 2);
+    }
+
+    char label[48];
+    if (o.gated)
+      std::snprintf(label, sizeof(label), "Motion: 0 (gated)");
+    else
+      std::snprintf(label, sizeof(label), "Motion: %g", o.motion);
+    cv::putText(frame_, label, cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX,
+                1.0, cv::Scalar(0, 0, 255), 2);
+  });
+  return frame_;
+}
+
+const std::vector<uchar> &MotionSnapshot::jpeg() const {
+  std::call_once(jpeg_once_, [this] {
+    const cv::Mat &img = frame();
+    if (!img.empty() && !cv::imencode(".jpg", img, jpeg_))
+      jpeg_.clear();
+  });
+  return jpeg_;
+}
+
+void CameraStream::publishMotionFrame(MotionOverlay overlay) {
+  overlay.region_scores = regionMotionScores();
+  auto snap = std::make_shared<const MotionSnapshot>(std::move(overlay),
+                                                     ++motion_seq_);
+  std::atomic_store(&motion_snapshot_,
+                    std::shared_ptr<const MotionSnapshot>(std::move(snap)));
+}
+
+bool CameraStream::motionViewerActive() const {
+  const int64_t last = last_view_ms_.load(std::memory_order_relaxed);
+  const int64_t timeoutMs =
+      int64_t(std::max(1, settings_.motion_view_timeout_seconds())) * 1000;
+  return last != 0 && steadyNowMs() - last <= timeoutMs;
+}
+
+std::shared_ptr<const MotionSnapshot> CameraStream::getMotionSnapshot() const {
+  last_view_ms_.store(steadyNowMs(), std::memory_order_relaxed);
+  return std::atomic_load(&motion_snapshot_);
+}
+
+std::shared_ptr<const std::vector<uchar>>
+CameraStream::getLastMotionJpeg() const {
+  auto snap = getMotionSnapshot();
+  if (!snap)
+    return nullptr;
+  // Aliasing constructor: the buffer lives as long as its snapshot
+  return std::shared_ptr<const std::vector<uchar>>(snap, &snap->jpeg());
+}
+
+cv::Mat CameraStream::getLastMotionFrame() const {
+  auto snap = getMotionSnapshot();
+  return snap ? snap->frame() : cv::Mat();
 }
 
-bool CameraStream::ProbeRtspAudio(const std::string &uri, AudioProbeResult &out,
-                                  int timeout_ms) {
-  // Pipeline: just rtspsrc; we don't even link pads.
-  GstElement *pipeline = gst_pipeline_new("probe-pipe");
-  GstElement *src = gst_element_factory_make("rtspsrc", "probe-src");
-  if (!pipeline || !src) {
-    if (pipeline)
-      gst_object_unref(pipeline);
-    return false;
+void CameraStream::updateMotionState(float avgMotion, int &motionHitCount,
+                                     bool segment_enabled) {
+  std::chrono::seconds motion_hold_duration(motion_hold_duration_);
+
+  // Check if motion exceeds threshold for detection logic
+  if (avgMotion > motion_threshold_) {
+    ++motionHitCount;
+    if (motionHitCount >= motion_min_hits_) {
+      std::cout << "[Motion] score: " << avgMotion << std::endl;
+      lastMotionTime_ = std::chrono::steady_clock::now();
+    }
+  } else {
+    // Decay hit count gently, don't zero immediately
+    if (motionHitCount > 0)
+      motionHitCount -= motion_decay_;
+  }
+
+  motionDetected_ = std::chrono::steady_clock::now() - lastMotionTime_ <=
+                    motion_hold_duration;
+
+  if (motionDetected_ != prevMotionDetected_)
+    std::cout << (motionDetected_ ? "[Motion] started." : "[Motion] stopped.");
+
+  // Pre-roll clips follow the motion state directly; the hold duration is
+  // the post-roll
+  if (preroll_ && motionDetected_ != prevMotionDetected_) {
+    if (motionDetected_)
+      preroll_->beginClip(output_path_ + "/" + getTimestampedFilename("clip-"));
+    else
+      preroll_->endClip();
+  }
+
+  // This applies only if motion-record = on
+  if (!segment_enabled)
+    return;
+
+  // Record-on-motion-only: let the pre-roll and live video through
+  if (segment_gate_ && motionDetected_ && !segment_gate_->isOpen()) {
+    if (segment_gate_->primed()) {
+      // The fragment left open when the gate closed ends with the previous
+      // event; drop it and start a new one at the pre-roll's keyframe
+      segmentWorker_->discardOpenFragment();
+      requestSegmentSplit();
+    }
+    segment_gate_->open();
   }
 
-  // Force TCP so results match your normal pipeline
-  // NOTE: 4 == GST_RTSP_LOWER_TRANS_TCP (avoids extra headers/libs)
-  g_object_set(src, "location", uri.c_str(), "protocols", 4, NULL);
+  if (motionDetected_)
+    segmentWorker_->SaveCurrentSegment();
+
+  bool motionTransition = (!motionDetected_ && prevMotionDetected_);
+  if (motionTransition) {
+    segmentWorker_->setState(
+        SegmentWorker::WorkerState::FinishRequested); // Finish current segment
+    // Gated: close the fragment at the next keyframe rather than after the
+    // full segment length, so the gate shuts soon after the hold expires
+    if (segment_gate_)
+      requestSegmentSplit();
+  }
 
-  gst_bin_add(GST_BIN(pipeline), src);
+  // We asked segmentworker to finish in previous tick, now theres new motion
+  if (segmentWorker_->getState() ==
+          SegmentWorker::WorkerState::FinishRequested &&
+      motionDetected_) {
+    std::cout << "[Motion] Segmentworker asked to finalize, but "
+                 "there was new motion!"
+              << std::endl;
+    // Back to work! Not time to finialize video yet
+    segmentWorker_->setState(SegmentWorker::WorkerState::Working);
+  }
 
-  // Simple sync between GLib callback thread and this thread
-  std::mutex m;
-  std::condition_variable cv;
-  std::atomic<bool> done{false};
+  // Export final output file !
+  if (segmentWorker_->getState() == SegmentWorker::WorkerState::Finalized) {
+    std::cout << "[Motion] Time to finish video" << std::endl;
 
-  Ctx ctx{&m, &cv, &done, &out};
+    auto segments = segmentWorker_->getAndResetMotionSegments();
 
-  // When pads appear, check caps for media=audio and encoding-name
-  gulong h_pad =
-      g_signal_connect(src, "pad-added", G_CALLBACK(on_pad_added), &ctx);
-  gulong h_nmp =
-      g_signal_connect(src, "no-more-pads", G_CALLBACK(on_no_more_pads), &ctx);
+    if (!segments.empty()) {
+      // e.g. motion-2025-07-29_21-15-43.mkv
+      std::string outputFilename = getTimestampedFilename();
+      queueExport(segments, output_path_, outputFilename);
+    } else
+      std::cout << "[Motion] No segments!!" << std::endl;
 
-  // Go to PAUSED so rtspsrc DESCRIBEs and exposes pads
-  gst_element_set_state(pipeline, GST_STATE_PAUSED);
+    segmentWorker_->setState(SegmentWorker::WorkerState::Working);
 
-  // Wait (bounded) until we know the answer
-  {
-    std::unique_lock<std::mutex> lk(m);
-    cv.wait_for(lk, std::chrono::milliseconds(timeout_ms),
-                [&] { return done.load(); });
+    if (segment_gate_ && !motionDetected_)
+      segment_gate_->close();
+  }
+}
+
+void CameraStream::downsampleForGate(const cv::Mat &gray, cv::Mat &small) {
+  // ~160px wide is plenty to notice change and keeps the diff in L1 cache
+  const int gateWidth = 160;
+  if (gray.cols <= gateWidth) {
+    gray.copyTo(small);
+    return;
   }
+  double f = static_cast<double>(gateWidth) / gray.cols;
+  cv::resize(gray, small, cv::Size(), f, f, cv::INTER_AREA);
+}
 
-  g_signal_handler_disconnect(src, h_pad);
-  g_signal_handler_disconnect(src, h_nmp);
+float CameraStream::changedPixelRatio(const cv::Mat &small,
+                                      const cv::Mat &ref, int pixelThreshold,
+                                      cv::Mat &diff) {
+  if (ref.empty() || small.size() != ref.size())
+    return -1.0f;
+
+  // absdiff/threshold/countNonZero are all vectorized inside OpenCV
+  cv::absdiff(small, ref, diff);
+  cv::threshold(diff, diff, pixelThreshold, 255, cv::THRESH_BINARY);
+  return static_cast<float>(cv::countNonZero(diff)) /
+         static_cast<float>(diff.total());
+}
 
-  // Cleanup
-  gst_element_set_state(pipeline, GST_STATE_NULL);
-  gst_object_unref(pipeline);
+void CameraStream::queueExport(
+    const std::vector<std::filesystem::path> &segments,
+    const std::filesystem::path &outputFolder,
+    const std::string &outputFilename) {
+  if (!export_scheduler_) {
+    // Standalone use: export on the motion loop
+    std::filesystem::path written;
+    if (!VideoExporter::exportSegments(segments, outputFolder, outputFilename,
+                                       &written))
+      std::cerr << "[MotionLoop] Export failed for " << outputFilename
+                << std::endl;
+    else if (retention_)
+      retention_->add(written);
+    return;
+  }
 
-  // If we timed out, we still return whatever we found (likely no audio)
-  return true;
+  ExportJob job{name_, segments, outputFolder, outputFilename};
+  if (!export_scheduler_->submit(std::move(job))) {
+    // Segments stay in saved/ and can still be assembled by hand
+    std::cerr << "[MotionLoop] Export queue full, dropped " << outputFilename
+              << " (" << segments.size() << " segments kept in saved/)"
+              << std::endl;
+  }
+}
+
+std::string CameraStream::getTimestampedFilename(const std::string &prefix,
+                                                 const std::string &ext) {
+  auto now = std::chrono::system_clock::now();
+  std::time_t now_c = std::chrono::system_clock::to_time_t(now);
+
+  std::tm tm;
+  localtime_r(&now_c, &tm); // Use localtime_s on Windows
+
+  std::ostringstream oss;
+  oss << prefix << std::put_time(&tm, "%Y-%m-%d_%H-%M-%S") << ext;
+
+  return oss.str(); // e.g., motion-2025-07-29_21-15-43.mp4
 }
 
 int CameraStream::addMotionRegion(const cv::Rect &rect, float angle) {
-  int id = next_region_id_++;
-  motion_regions_.emplace_back(id, rect, angle);
+  int id;
+  {
+    std::lock_guard<std::mutex> lk(regions_mutex_);
+    id = next_region_id_++;
+    motion_regions_.emplace_back(id, rect, angle);
+  }
+  regions_version_++;
   std::cout << "[MotionRegion] Added region " << id << " at (" << rect.x << ","
             << rect.y << ") size " << rect.width << "x" << rect.height
             << " angle " << angle << "°" << std::endl;
@@ -720,14 +1553,18 @@ int CameraStream::addMotionRegion(const cv::Rect &rect, float angle) {
 }
 
 bool CameraStream::removeMotionRegion(int id) {
-  auto it = std::find_if(
-      motion_regions_.begin(), motion_regions_.end(),
-      [id](const MotionRegion &region) { return region.id == id; });
-
-  if (it != motion_regions_.end()) {
-    std::cout << "[MotionRegion] Removed region " << id << std::endl;
-    motion_regions_.erase(it);
-    return true;
+  {
+    std::lock_guard<std::mutex> lk(regions_mutex_);
+    auto it = std::find_if(
+        motion_regions_.begin(), motion_regions_.end(),
+        [id](const MotionRegion &region) { return region.id == id; });
+
+    if (it != motion_regions_.end()) {
+      motion_regions_.erase(it);
+      regions_version_++;
+      std::cout << "[MotionRegion] Removed region " << id << std::endl;
+      return true;
+    }
   }
 
   std::cout << "[MotionRegion] Region " << id << " not found for removal"
@@ -736,7 +1573,84 @@ bool CameraStream::removeMotionRegion(int id) {
 }
 
 void CameraStream::clearMotionRegions() {
-  std::cout << "[MotionRegion] Cleared " << motion_regions_.size() << " regions"
-            << std::endl;
-  motion_regions_.clear();
-}
\ No newline at end of file
+  size_t cleared;
+  {
+    std::lock_guard<std::mutex> lk(regions_mutex_);
+    cleared = motion_regions_.size();
+    motion_regions_.clear();
+  }
+  regions_version_++;
+  std::cout << "[MotionRegion] Cleared " << cleared << " regions" << std::endl;
+}
+
+std::vector<MotionRegion> CameraStream::getMotionRegions() const {
+  std::lock_guard<std::mutex> lk(regions_mutex_);
+  return motion_regions_;
+}
+
+std::vector<RegionMotionScore> CameraStream::regionMotionScores() const {
+  std::lock_guard<std::mutex> lk(regions_mutex_);
+  return region_scores_;
+}
+
+void CameraStream::publishRegionScores(const MotionLoopState &st) {
+  std::lock_guard<std::mutex> lk(regions_mutex_);
+  const MotionDetectorResult &res = st.result;
+  region_scores_.resize(res.regionScore.size());
+  for (size_t i = 0; i < res.regionScore.size(); ++i) {
+    RegionMotionScore &r = region_scores_[i];
+    r.region_id = st.regions[i].id;
+    r.points = res.regionPoints[i];
+    r.score = res.regionScore[i];
+  }
+}
+
+void CameraStream::buildRegionMask(const cv::Size &frameSize,
+                                   MotionLoopState &st) const {
+  {
+    std::lock_guard<std::mutex> lk(regions_mutex_);
+    st.regions = motion_regions_;
+  }
+
+  // One score slot per region
+  const size_t slots = std::min<size_t>(st.regions.size(), 255);
+  st.regionArea.assign(slots, 0);
+
+  // No regions: analyze the whole frame
+  if (st.regions.empty()) {
+    st.regionMask.release();
+    return;
+  }
+  if (st.regions.size() > slots)
+    std::cerr << "[MotionRegion] " << name_ << ": only the first " << slots
+              << " regions are analyzed" << std::endl;
+
+  // Pixel value = region slot + 1, 0 = outside every region. Doubles as
+  // the goodFeaturesToTrack mask (non-zero = detect). Where regions
+  // overlap, the one added last wins.
+  st.regionMask.create(frameSize, CV_8UC1);
+  st.regionMask.setTo(cv::Scalar(0));
+  for (size_t i = 0; i < slots; ++i) {
+    const MotionRegion &region = st.regions[i];
+    const cv::Scalar value(static_cast<double>(i + 1));
+    if (region.angle == 0.0f) {
+      cv::rectangle(st.regionMask, region.rect, value, cv::FILLED);
+    } else {
+      cv::Point2f vertices[4];
+      region.getRotatedRect().points(vertices);
+      cv::Point poly[4];
+      for (int j = 0; j < 4; j++)
+        poly[j] = vertices[j];
+      cv::fillConvexPoly(st.regionMask, poly, 4, value);
+    }
+  }
+
+  // Visible area of each region, for the pixel engines' percentages
+  for (int y = 0; y < st.regionMask.rows; ++y) {
+    const uchar *row = st.regionMask.ptr<uchar>(y);
+    for (int x = 0; x < st.regionMask.cols; ++x) {
+      if (row[x])
+        ++st.regionArea[row[x] - 1];
+    }
+  }
+}
@@ -1,21 +1,30 @@
 #pragma once
+#include "ContinuousRecorder.h"
+#include "ExportScheduler.h"
+#include "GstRuntime.h"
+#include "MotionDetector.h"
+#include "MotionVectorDecoder.h"
+#include "MotionScheduler.h"
+#include "PrerollRecorder.h"
+#include "RetentionManager.h"
+#include "SegmentGate.h"
 #include "SegmentWorker.h"
 #include "Settings.h"
+#include "StreamProber.h"
+#include "StreamSupervisor.h"
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <gst/app/gstappsink.h>
 #include <gst/gst.h>
+#include <gst/video/video.h>
+#include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <thread>
 #include <vector>
 
-struct AudioProbeResult {
-  bool has_audio = false;
-  std::string encoding;
-  int channels = 0;
-  int rate = 0;
-  bool probed = false;
-};
-
 struct MotionRegion {
   int id;
   cv::Rect rect;
@@ -32,6 +41,84 @@ struct MotionRegion {
   }
 };
 
+// How much of the H.264 stream the motion branch decodes
+enum class MotionDecodeMode {
+  Full,         // Every frame; videorate drops after decode
+  NonReference, // Units whose slices are all nal_ref_idc 0 are dropped
+                // before the decoder
+  KeyframesOnly // Delta units dropped before the decoder
+};
+
+const char *motionDecodeModeToString(MotionDecodeMode mode);
+MotionDecodeMode motionDecodeModeFromString(const std::string &s);
+
+// Motion in one region on the last analyzed frame
+struct RegionMotionScore {
+  int region_id = 0;
+  // The engine's score: average displacement of the moving points in px
+  // for optical flow, percent of the region's pixels moving otherwise
+  float score = 0.0f;
+  int points = 0; // Moving points (optical flow) or pixels
+};
+
+// What the analysis of one frame produced, kept compact so the overlay can
+// be drawn later, and only if someone looks at it
+struct MotionOverlay {
+  cv::Mat frame; // Analysis frame, gray or BGR
+  std::vector<MotionRegion> regions;
+  std::vector<MotionVector> vectors;
+  cv::Mat foreground; // Moving pixels, from the pixel engines
+  std::vector<RegionMotionScore> region_scores;
+  float motion = 0.0f; // Frame score
+  bool gated = false;  // Stopped by the frame-difference pre-gate
+};
+
+// One published motion frame. Immutable once published; the overlay is
+// drawn and the JPEG encoded on first request, then shared by every
+// reader of this frame.
+class MotionSnapshot {
+public:
+  MotionSnapshot(MotionOverlay overlay, uint64_t seq)
+      : overlay_(std::move(overlay)), seq_(seq) {}
+
+  const MotionOverlay &overlay() const { return overlay_; }
+  // BGR frame with regions, vectors and the motion label drawn on
+  const cv::Mat &frame() const;
+  uint64_t seq() const { return seq_; }
+  // Empty if encoding failed
+  const std::vector<uchar> &jpeg() const;
+
+private:
+  MotionOverlay overlay_;
+  uint64_t seq_;
+  mutable std::once_flag frame_once_;
+  mutable cv::Mat frame_;
+  mutable std::once_flag jpeg_once_;
+  mutable std::vector<uchar> jpeg_;
+};
+
+// Per-camera motion loop counters (snapshot)
+struct MotionStats {
+  uint64_t frames_gated = 0;    // Stopped by the frame-difference pre-gate
+  uint64_t frames_analyzed = 0; // Scored by the motion engine
+  // cv::Mat buffers allocated by the motion loop on analyzed frames,
+  // summed and for the last one. Steady state is none without a viewer, the
+  // published frame with one, plus goodFeaturesToTrack's scratch on frames
+  // that re-detect features. Other heap allocations (vectors, GStreamer
+  // buffers, the JPEG) are not counted.
+  uint64_t analyzed_mat_allocs = 0;
+  uint64_t last_frame_mat_allocs = 0;
+  // Detector time on analyzed frames since the engine was last selected
+  MotionEngine engine = MotionEngine::OpticalFlow;
+  uint64_t engine_frames = 0;
+  uint64_t engine_us = 0;
+  uint64_t last_engine_us = 0;
+  uint64_t engine_fallbacks = 0; // Motion vectors: frames optical flow decided
+  // Motion vectors: access units dropped, whole GOPs at a time, because
+  // analysis fell behind
+  uint64_t engine_units_dropped = 0;
+};
+
 class CameraStream {
 public:
   CameraStream(const std::string &name, const std::string &uri,
@@ -46,26 +133,65 @@ public:
                float motion_frame_scale = 1.0f, float noise_threshold = 0.0f,
                float motion_threshold = 0.0f, int motion_min_hits = 1,
                int motion_decay = 0, float motion_arrow_scale = 2.5f,
-               int motion_arrow_thickness = 1,
+               int motion_arrow_thickness = 1, int motion_fps = 10,
+               MotionDecodeMode motion_decode_mode = MotionDecodeMode::Full,
+               bool preroll_recording = false, bool segment_on_motion = false,
                std::string video_output_format = "mp4");
 
   ~CameraStream();
 
   void start();
   void stop();
+  // "starting" until the pipeline reaches PLAYING, then "running"; "failed"
+  // if it could not be built or a state change failed, "stopped" otherwise.
+  // Never blocks on the pipeline.
+  const char *state() const;
 
   // Feature toggles
   void enableSegmentRecording();
   void disableSegmentRecording();
-  void enableFullRecording(const std::string &filename);
+  // Continuous 24/7 recording into <media>/<camera>/continuous (see
+  // ContinuousRecorder for the layout and index)
+  void enableFullRecording();
   void disableFullRecording();
   void enableTimestampOverlay();
   void disableTimestampOverlay();
   void enableMotionFrameSaving(const std::string &outPath);
   void disableMotionFrameSaving();
+  // Motion clips from an in-memory pre-roll of encoded packets (needs the
+  // motion loop for its start/stop trigger)
+  void enablePrerollRecording();
+  void disablePrerollRecording();
+  // Segment recording only writes while there is motion; idle footage stays
+  // in an in-memory pre-roll (needs segment recording and the motion loop)
+  void enableSegmentOnMotion();
+  void disableSegmentOnMotion();
 
   std::string getMountPoint() const;
 
+  // Run motion analysis on a shared pool instead of a per-camera thread.
+  // Must be set before start().
+  void setMotionScheduler(MotionScheduler *scheduler) {
+    motion_scheduler_ = scheduler;
+  }
+  // Queue motion clip exports on a shared, bounded pool
+  void setExportScheduler(ExportScheduler *scheduler) {
+    export_scheduler_ = scheduler;
+  }
+  // Report finished clips and recording files for quota enforcement. Must
+  // be set before start().
+  void setRetentionManager(RetentionManager *retention) {
+    retention_ = retention;
+  }
+  // Restarts the pipeline when it dies or stalls; set before start()
+  void setStreamSupervisor(StreamSupervisor *supervisor) {
+    supervisor_ = supervisor;
+  }
+  SupervisedStreamStats supervisorStats() const;
+  // Bus errors and EOS are dispatched on this runtime's main context; set
+  // before start(). Without one they're handled on the posting thread.
+  void setGstRuntime(GstRuntime *runtime) { gst_runtime_ = runtime; }
+
   // Getters/setters
   const AudioProbeResult &audioProbe() const { return pr_; }
   bool hasAudioHint() const { return pr_.has_audio; }
@@ -74,8 +200,16 @@ public:
   const std::string &uri() const { return uri_; }
   bool segment() const { return segment_; }
   bool recording() const { return recording_; }
+  std::filesystem::path recordingRoot() const;
+  RecordingStats recordingStats() const;
   bool overlay() const { return overlay_; }
   bool motion_frame() const { return motion_frame_; }
+  bool preroll_recording() const { return preroll_recording_; }
+  PrerollStats prerollStats() const;
+  bool segment_on_motion() const { return segment_on_motion_; }
+  bool segmentGateOpen() const {
+    return segment_gate_ && segment_gate_->isOpen();
+  }
   bool getGstreamerEncodedProxy() const { return gstreamerEncodedProxy_; }
   bool getLive555Proxied() const { return live555Proxied_; }
   int getProxyBitrate() const { return proxy_bitrate_; }
@@ -84,15 +218,32 @@ public:
   const std::string &getSegmentSpeedPreset() const {
     return segment_speed_preset_;
   }
-  // Returns the last detected motion frame as a JPEG buffer
-  const std::vector<uchar> &getLastMotionJpeg() const { return last_jpeg_buf_; }
-  const cv::Mat &getLastMotionFrame() const { return last_motion_frame_; }
+  // Latest published motion frame (null before the first one). Counts as
+  // a viewer: frames are only published for motion_view_timeout_seconds
+  // after the last call. Safe from any thread; never blocks the motion loop.
+  std::shared_ptr<const MotionSnapshot> getMotionSnapshot() const;
+  bool hasMotionSnapshot() const {
+    return std::atomic_load(&motion_snapshot_) != nullptr;
+  }
+  // Returns the last motion frame as a JPEG buffer (encoded once per frame)
+  std::shared_ptr<const std::vector<uchar>> getLastMotionJpeg() const;
+  cv::Mat getLastMotionFrame() const;
   void setMotionFrameSize(const cv::Size &sz) { motion_frame_size_ = sz; }
   cv::Size getMotionFrameSize() const { return motion_frame_size_; }
 
   void setMotionFrameScale(float s) { motion_frame_scale_ = s; }
   float getMotionFrameScale() const { return motion_frame_scale_; }
 
+  // Motion analysis rate cap (frames/s, 0 = every decoded frame). Applied
+  // in the pipeline, so changing it rebuilds a running stream.
+  void setMotionFps(int fps);
+  int getMotionFps() const { return motion_fps_; }
+
+  // Decode mode for the motion branch. Also a pipeline setting, so changing
+  // it rebuilds a running stream.
+  void setMotionDecodeMode(MotionDecodeMode mode);
+  MotionDecodeMode getMotionDecodeMode() const { return motion_decode_mode_; }
+
   void setNoiseThreshold(float t) { noise_threshold_ = t; }
   float getNoiseThreshold() const { return noise_threshold_; }
 
@@ -111,6 +262,43 @@ public:
   void setMotionArrowThickness(int t) { motion_arrow_thickness_ = t; }
   int getMotionArrowThickness() const { return motion_arrow_thickness_; }
 
+  // Tracked features are re-detected every N analyzed frames, or earlier when
+  // fewer than ratio * (points found at last detection) are still tracked.
+  void setFeatureRedetectInterval(int n) { feature_redetect_interval_ = n; }
+  int getFeatureRedetectInterval() const { return feature_redetect_interval_; }
+
+  void setFeatureMinSurvivorRatio(float r) { feature_min_survivor_ratio_ = r; }
+  float getFeatureMinSurvivorRatio() const {
+    return feature_min_survivor_ratio_;
+  }
+
+  // Frame-difference pre-gate: optical flow only runs when at least this
+  // fraction of (downsampled) pixels changed by more than the pixel
+  // threshold since the last analyzed frame. 0 disables the gate.
+  void setDiffGateRatio(float r) { diff_gate_ratio_ = r; }
+  float getDiffGateRatio() const { return diff_gate_ratio_; }
+
+  void setDiffGatePixelThreshold(int t) { diff_gate_pixel_threshold_ = t; }
+  int getDiffGatePixelThreshold() const { return diff_gate_pixel_threshold_; }
+
+  // Motion detector engine; switched by the motion loop on its next frame
+  // (rebuilds the pipeline when switching to or from motion vectors)
+  void setMotionEngine(MotionEngine engine);
+  MotionEngine getMotionEngine() const { return motion_engine_; }
+
+  MotionStats motionStats() const {
+    return MotionStats{frames_gated_.load(),
+                       frames_analyzed_.load(),
+                       analyzed_mat_allocs_.load(),
+                       last_frame_mat_allocs_.load(),
+                       motion_engine_.load(),
+                       engine_frames_.load(),
+                       engine_us_.load(),
+                       last_engine_us_.load(),
+                       engine_fallbacks_.load(),
+                       engine_units_dropped_.load()};
+  }
+
   void setVideoOutputFormat(const std::string &fmt) {
     video_output_format_ = fmt;
   }
@@ -122,30 +310,120 @@ public:
   int addMotionRegion(const cv::Rect &rect, float angle = 0.0f);
   bool removeMotionRegion(int id);
   void clearMotionRegions();
-  const std::vector<MotionRegion> &getMotionRegions() const {
-    return motion_regions_;
-  }
+  std::vector<MotionRegion> getMotionRegions() const;
+  // Empty until the motion loop analyzed a frame with regions set
+  std::vector<RegionMotionScore> regionMotionScores() const;
 
 private:
   std::string buildPipelineWithAudio() const;
   std::string buildPipelineWithoutAudio() const;
+  std::string buildMotionBranch() const;
+  std::string buildRecordBranch() const;
+  std::string segmentQueue(const std::string &name) const;
+  void requestSegmentSplit();
+  cv::Size motionAnalysisSize() const;
   void startMotionLoop();
+  void stopMotionLoop();
+  static GstFlowReturn onMotionSample(GstAppSink *sink, gpointer user_data);
+  static GstFlowReturn onPrerollSample(GstAppSink *sink, gpointer user_data);
+  static GstFlowReturn onRecordSample(GstAppSink *sink, gpointer user_data);
+  static GstBusSyncReply onBusMessage(GstBus *bus, GstMessage *msg,
+                                      gpointer user_data);
+  void handleBusFailure(GstMessage *msg);
+  static GstPadProbeReturn onVideoBuffer(GstPad *pad, GstPadProbeInfo *info,
+                                         gpointer user_data);
+  static GstPadProbeReturn onMotionUnit(GstPad *pad, GstPadProbeInfo *info,
+                                        gpointer user_data);
+  static GstPadProbeReturn onMotionNonRefUnit(GstPad *pad,
+                                              GstPadProbeInfo *info,
+                                              gpointer user_data);
+  void startPipeline();
+  void stopPipeline();
+  bool restartPipeline(); // Supervisor thread
+  void drainMotionSamples();
+  void processMotionSample(GstSample *sample);
+  // Motion vector engine: H.264 access units instead of decoded frames
+  void processEncodedMotionSample(GstSample *sample);
   void rebuild();
-  void exportInBackground(const std::vector<std::filesystem::path> &segments,
-                          const std::filesystem::path &outputFolder,
-                          const std::string &outputFilename);
+  void updateMotionState(float avgMotion, int &motionHitCount,
+                         bool segment_enabled);
+  static void downsampleForGate(const cv::Mat &gray, cv::Mat &small);
+  static float changedPixelRatio(const cv::Mat &small, const cv::Mat &ref,
+                                 int pixelThreshold, cv::Mat &diff);
+  void queueExport(const std::vector<std::filesystem::path> &segments,
+                   const std::filesystem::path &outputFolder,
+                   const std::string &outputFilename);
   std::string getTimestampedFilename(const std::string &prefix = "motion-",
                                      const std::string &ext = ".mkv");
 
-  static bool ProbeRtspAudio(const std::string &uri, AudioProbeResult &out,
-                             int timeout_ms = 1500);
-
   AudioProbeResult pr_;
 
   std::unique_ptr<SegmentWorker> segmentWorker_;
+  std::unique_ptr<SegmentGate> segment_gate_;
 
   GstElement *motion_sink_ = nullptr;
-  std::thread motion_thread_;
+  GstElement *preroll_sink_ = nullptr;
+  std::unique_ptr<PrerollRecorder> preroll_;
+  GstElement *record_sink_ = nullptr;
+  std::unique_ptr<ContinuousRecorder> recorder_;
+  std::thread motion_thread_; // Only used without a scheduler
+  MotionScheduler *motion_scheduler_ = nullptr;
+  ExportScheduler *export_scheduler_ = nullptr;
+  RetentionManager *retention_ = nullptr;
+  StreamSupervisor *supervisor_ = nullptr;
+  SupervisedStreamHandle supervised_; // std::atomic_load/atomic_store
+  GstRuntime *gst_runtime_ = nullptr;
+  GSource *bus_watch_ = nullptr; // On gst_runtime_, per pipeline
+  // start/stop/rebuild vs. supervisor restarts and state()
+  mutable std::mutex pipeline_mutex_;
+  MotionStreamHandle motion_stream_;
+
+  // Analysis state carried from one motion frame to the next. Buffers are
+  // reused from frame to frame, so a steady stream allocates nothing but
+  // the published visualization.
+  struct MotionLoopState {
+    // Ping-pong gray frames: slot cur receives the new frame, prevGray
+    // refers to the other one. A frame is either the Y plane of its
+    // still-mapped buffer (held, no copy) or a resized/converted image in
+    // grayBuf.
+    struct HeldFrame {
+      GstVideoFrame frame{};
+      bool mapped = false;
+      void release();
+    };
+    HeldFrame held[2];
+    cv::Mat grayBuf[2];
+    int cur = 0;
+    cv::Mat prevGray;
+    cv::Mat colorBuf, scaledBuf; // RGB/BGR input conversions
+    int motionHitCount = 0;
+
+    // Engine selected by motion_engine_, with its own frame history
+    std::unique_ptr<MotionDetector> detector;
+    MotionDetectorResult result;
+    // Motion vector engine: decoder and this frame's vectors, scaled to
+    // analysis size
+    std::unique_ptr<MotionVectorDecoder> mvDecoder;
+    std::vector<MotionVector> blockVectors;
+
+    // Regions as of the last change, rasterized at analysis size: pixel =
+    // index into regions + 1, 0 = outside. Empty without regions.
+    std::vector<MotionRegion> regions;
+    cv::Mat regionMask;
+    cv::Size regionMaskSize;
+    unsigned regionMaskVersion = 0;
+    std::vector<int> regionArea; // Mask pixels per region slot
+
+    // Downsampled last-analyzed frame for the frame-difference pre-gate
+    cv::Mat gateRef, gateSmall, gateDiff;
+  };
+  MotionLoopState motion_state_;
+  void buildRegionMask(const cv::Size &frameSize, MotionLoopState &st) const;
+  // Per frame: (re)creates the engine and the region mask as needed
+  void prepareMotionState(const cv::Size &frameSize, MotionLoopState &st);
+  void scoreMotionFrame(MotionLoopState &st, const MotionDetectorInput &in,
+                        const cv::Mat &frame, bool segment_enabled);
+  void publishRegionScores(const MotionLoopState &st);
 
   using Clock = std::chrono::steady_clock;
   std::chrono::steady_clock::time_point lastMotionTime_;
@@ -157,18 +435,46 @@ private:
   float motion_arrow_scale_ = 2.5f;
   int motion_arrow_thickness_ = 1;
   float motion_frame_scale_ = 1.0f;
+  int motion_fps_ = 10;
+  MotionDecodeMode motion_decode_mode_ = MotionDecodeMode::Full;
+  std::atomic<int> feature_redetect_interval_{10};
+  std::atomic<float> feature_min_survivor_ratio_{0.5f};
+  std::atomic<float> diff_gate_ratio_{0.002f};
+  std::atomic<int> diff_gate_pixel_threshold_{12};
+  std::atomic<uint64_t> frames_gated_{0};
+  std::atomic<uint64_t> frames_analyzed_{0};
+  std::atomic<uint64_t> analyzed_mat_allocs_{0};
+  std::atomic<uint64_t> last_frame_mat_allocs_{0};
+  std::atomic<MotionEngine> motion_engine_{MotionEngine::OpticalFlow};
+  std::atomic<uint64_t> engine_frames_{0};
+  std::atomic<uint64_t> engine_us_{0};
+  std::atomic<uint64_t> last_engine_us_{0};
+  std::atomic<uint64_t> engine_fallbacks_{0};
+  std::atomic<uint64_t> engine_units_dropped_{0};
+  // Motion vector engine: access units buffered ahead of the appsink, and
+  // whether units are being dropped until the next keyframe
+  static constexpr guint kMotionUnitQueue = 64;
+  std::atomic<bool> motion_unit_resync_{false};
   bool motionDetected_ = false;
   bool prevMotionDetected_ = false;
   std::string video_output_format_ = "mp4";
   std::string output_path_;
 
-  cv::Mat last_motion_frame_;
+  void publishMotionFrame(MotionOverlay overlay);
+  bool motionViewerActive() const;
+
+  // Swapped atomically by the motion loop, read by HTTP handlers
+  std::shared_ptr<const MotionSnapshot> motion_snapshot_;
+  uint64_t motion_seq_ = 0;
+  mutable std::atomic<int64_t> last_view_ms_{0}; // Steady clock
   cv::Size motion_frame_size_{0, 0};
-  std::vector<uchar> last_jpeg_buf_;
 
-  // Motion regions
+  // Motion regions; the motion loop works on a copy taken on change
+  mutable std::mutex regions_mutex_; // Guards the regions and scores
   std::vector<MotionRegion> motion_regions_;
+  std::vector<RegionMotionScore> region_scores_;
   int next_region_id_ = 1;
+  std::atomic<unsigned> regions_version_{0}; // Bumped on every region change
 
   std::string name_;
   std::string uri_;
@@ -176,16 +482,18 @@ private:
 
   void *pipeline_ = nullptr;
   bool running_ = false;
-  bool motion_running_ = false;
+  bool start_failed_ = false;
+  std::atomic<bool> motion_running_{false};
 
   // Feature toggles/settings
   std::atomic<bool> segment_{false};
   bool recording_ = false;
   bool gstreamerEncodedProxy_ = false;
   bool live555Proxied_ = false;
-  std::string recordFile_;
   bool overlay_ = false;
   bool motion_frame_ = false;
+  bool preroll_recording_ = false;
+  bool segment_on_motion_ = false;
   std::string motionFile_;
   Settings &settings_;
   int segment_bitrate_;
@@ -0,0 +1,261 @@
+#include "ContinuousRecorder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int64_t toMs(std::chrono::system_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             t.time_since_epoch())
+      .count();
+}
+
+std::string fileName(uint32_t secondOfHour) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%02u-%02u.ts", secondOfHour / 60,
+                secondOfHour % 60);
+  return buf;
+}
+
+std::tm utc(int64_t wallMs) {
+  std::time_t t = static_cast<std::time_t>(wallMs / 1000);
+  std::tm tm;
+  gmtime_r(&t, &tm); // or gmtime_s on Windows
+  return tm;
+}
+
+fs::path hourDirFor(const fs::path &root, int64_t wallMs) {
+  std::tm tm = utc(wallMs);
+  char day[16], hour[8];
+  std::strftime(day, sizeof(day), "%Y-%m-%d", &tm);
+  std::strftime(hour, sizeof(hour), "%H", &tm);
+  return root / day / hour;
+}
+
+// Last entry with wall_ms <= t, by binary search over the index file
+bool searchIndex(const fs::path &indexPath, int64_t t,
+                 RecordingIndexEntry &out) {
+  std::FILE *f = std::fopen(indexPath.string().c_str(), "rb");
+  if (!f)
+    return false;
+
+  std::error_code ec;
+  uint64_t count = fs::file_size(indexPath, ec) / sizeof(RecordingIndexEntry);
+  if (ec)
+    count = 0;
+
+  auto readAt = [f](uint64_t i, RecordingIndexEntry &e) {
+    return std::fseek(f, static_cast<long>(i * sizeof(e)), SEEK_SET) == 0 &&
+           std::fread(&e, sizeof(e), 1, f) == 1;
+  };
+
+  // Upper bound: first entry after t
+  uint64_t lo = 0, hi = count;
+  RecordingIndexEntry e{};
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (!readAt(mid, e))
+      break;
+    if (e.wall_ms <= t)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  bool found = lo > 0 && readAt(lo - 1, out);
+  std::fclose(f);
+  return found;
+}
+
+} // namespace
+
+ContinuousRecorder::ContinuousRecorder(const std::string &name,
+                                       const fs::path &root,
+                                       int segmentSeconds)
+    : name_(name), root_(root),
+      segmentLength_(segmentSeconds > 0 ? segmentSeconds : 300) {}
+
+ContinuousRecorder::~ContinuousRecorder() { stop(); }
+
+void ContinuousRecorder::stop() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  closeFile();
+}
+
+void ContinuousRecorder::pushSample(GstSample *sample) {
+  GstBuffer *buf = gst_sample_get_buffer(sample);
+  if (!buf) {
+    gst_sample_unref(sample);
+    return;
+  }
+  bool keyframe = !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+  GstClockTime pts = GST_BUFFER_PTS(buf);
+
+  std::lock_guard<std::mutex> lk(mutex_);
+
+  if (keyframe) {
+    auto now = std::chrono::system_clock::now();
+    // Hour and file boundaries follow the wall clock, kept ahead of the
+    // last indexed keyframe
+    int64_t nowMs = std::max(toMs(now), lastIndexedMs_ + 1);
+    int64_t hour = nowMs / 3600000;
+
+    // Only ever roll over on a keyframe so every file is self-contained
+    bool rollover =
+        !data_ || hour != fileHour_ || now - fileOpened_ >= segmentLength_;
+    int64_t wallMs = nowMs; // Keyframes without a PTS take the wall clock
+    if (!rollover && GST_CLOCK_TIME_IS_VALID(pts) &&
+        (!wallClockMs(pts, wallMs) ||
+         std::abs(wallMs - nowMs) > kMaxPtsDriftMs)) {
+      // PTS reset or jumped (e.g. the camera reconnected): the anchor no
+      // longer holds, so start a new file on a fresh one
+      std::cerr << "[ContinuousRecorder] " << name_
+                << ": stream time discontinuity, starting a new file"
+                << std::endl;
+      rollover = true;
+    }
+
+    if (rollover) {
+      closeFile();
+      // Re-anchor on the wall clock; PTS only times keyframes within a file
+      anchorWallMs_ = nowMs;
+      anchorPts_ = pts;
+      if (openFile(now))
+        fileHour_ = hour;
+      wallMs = nowMs;
+    }
+    if (data_)
+      appendIndex(wallMs);
+  }
+
+  if (!data_) {
+    // Nothing to attach to until the first keyframe (or the disk failed)
+    gst_sample_unref(sample);
+    return;
+  }
+
+  GstMapInfo map;
+  if (gst_buffer_map(buf, &map, GST_MAP_READ)) {
+    size_t n = std::fwrite(map.data, 1, map.size, data_);
+    offset_ += n;
+    bytesWritten_ += n;
+    if (n != map.size)
+      std::cerr << "[ContinuousRecorder] " << name_ << ": short write to "
+                << dataPath_ << std::endl;
+    gst_buffer_unmap(buf, &map);
+  }
+  gst_sample_unref(sample);
+}
+
+bool ContinuousRecorder::openFile(std::chrono::system_clock::time_point when) {
+  int64_t wallMs = anchorWallMs_;
+  fs::path dir = hourDirFor(root_, wallMs);
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+
+  std::tm tm = utc(wallMs);
+  fileSecond_ = static_cast<uint32_t>(tm.tm_min * 60 + tm.tm_sec);
+  dataPath_ = dir / fileName(fileSecond_);
+
+  // Append: a restart within the same second continues the same file
+  data_ = std::fopen(dataPath_.string().c_str(), "ab");
+  index_ = std::fopen((dir / "index.bin").string().c_str(), "ab");
+  if (!data_ || !index_) {
+    std::cerr << "[ContinuousRecorder] " << name_ << ": cannot open "
+              << dataPath_ << std::endl;
+    closeFile();
+    return false;
+  }
+
+  offset_ = fs::file_size(dataPath_, ec);
+  if (ec)
+    offset_ = 0;
+  fileOpened_ = when;
+  filesWritten_++;
+
+  std::cout << "[ContinuousRecorder] " << name_ << ": recording to "
+            << dataPath_ << std::endl;
+  return true;
+}
+
+void ContinuousRecorder::closeFile() {
+  bool finished = data_ != nullptr;
+  if (data_)
+    std::fclose(data_);
+  if (index_)
+    std::fclose(index_);
+  data_ = nullptr;
+  index_ = nullptr;
+  if (finished && onFileClosed_)
+    onFileClosed_(dataPath_);
+  dataPath_.clear();
+  fileHour_ = -1;
+}
+
+void ContinuousRecorder::appendIndex(int64_t wallMs) {
+  // Never behind the previous entry, so index.bin stays sorted for
+  // searchIndex() whatever the camera's clock does
+  wallMs = std::max(wallMs, lastIndexedMs_ + 1);
+
+  // Data before the keyframe goes out first, so an indexed offset is never
+  // ahead of what is on disk by more than the keyframe itself
+  std::fflush(data_);
+
+  RecordingIndexEntry e{};
+  e.wall_ms = wallMs;
+  e.offset = offset_;
+  e.file = fileSecond_;
+  std::fwrite(&e, sizeof(e), 1, index_);
+  std::fflush(index_);
+  lastIndexedMs_ = wallMs;
+  keyframesIndexed_++;
+}
+
+bool ContinuousRecorder::wallClockMs(GstClockTime pts, int64_t &wallMs) const {
+  if (!GST_CLOCK_TIME_IS_VALID(pts) || !GST_CLOCK_TIME_IS_VALID(anchorPts_) ||
+      pts < anchorPts_)
+    return false;
+  wallMs =
+      anchorWallMs_ + static_cast<int64_t>((pts - anchorPts_) / GST_MSECOND);
+  return true;
+}
+
+RecordingStats ContinuousRecorder::stats() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  RecordingStats st;
+  st.active = data_ != nullptr;
+  st.current_file = dataPath_.string();
+  st.bytes_written = bytesWritten_;
+  st.files_written = filesWritten_;
+  st.keyframes_indexed = keyframesIndexed_;
+  return st;
+}
+
+fs::path
+ContinuousRecorder::hourDir(const fs::path &root,
+                            std::chrono::system_clock::time_point when) {
+  return hourDirFor(root, toMs(when));
+}
+
+bool ContinuousRecorder::seek(const fs::path &root,
+                              std::chrono::system_clock::time_point when,
+                              RecordingPosition &out) {
+  int64_t t = toMs(when);
+
+  // The keyframe can be in the previous hour when t is early in its hour
+  for (int back = 0; back < 2; ++back) {
+    fs::path dir = hourDirFor(root, t - back * 3600000LL);
+    RecordingIndexEntry e{};
+    if (!searchIndex(dir / "index.bin", t, e))
+      continue;
+    out.file = dir / fileName(e.file);
+    out.offset = e.offset;
+    out.keyframe_ms = e.wall_ms;
+    return true;
+  }
+  return false;
+}
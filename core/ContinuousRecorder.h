@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <gst/gst.h>
+#include <mutex>
+#include <string>
+
+// One keyframe in a recording hour. index.bin in every hour directory is a
+// flat array of these in host byte order, appended as keyframes arrive, so
+// it is sorted by time and can be binary searched in place.
+struct RecordingIndexEntry {
+  int64_t wall_ms; // Unix time of the keyframe, milliseconds
+  uint64_t offset; // Byte offset of the keyframe's first TS packet
+  uint32_t file;   // File start, seconds into the hour (file name MM-SS.ts)
+  uint32_t reserved;
+};
+static_assert(sizeof(RecordingIndexEntry) == 24, "index layout is on disk");
+
+// Result of a wall-clock lookup
+struct RecordingPosition {
+  std::filesystem::path file;
+  uint64_t offset = 0;
+  int64_t keyframe_ms = 0; // Time of the keyframe at offset (<= requested)
+};
+
+struct RecordingStats {
+  bool active = false;
+  std::string current_file;
+  uint64_t bytes_written = 0;
+  uint64_t files_written = 0;
+  uint64_t keyframes_indexed = 0;
+};
+
+// Continuous 24/7 recording of a camera's MPEG-TS stream.
+//
+// Layout under the recording root, all times UTC so DST changes never
+// produce a repeated or missing hour:
+//
+//   <root>/YYYY-MM-DD/HH/MM-SS.ts   files, each starting at a keyframe
+//   <root>/YYYY-MM-DD/HH/index.bin  RecordingIndexEntry per keyframe
+//
+// Files roll over at the first keyframe after segmentSeconds, and always at
+// an hour boundary, so a file never spans two hour directories. Every index
+// offset is packet aligned and mpegtsmux repeats PAT/PMT ahead of
+// keyframes, so a reader can start decoding right at any indexed offset.
+class ContinuousRecorder {
+public:
+  ContinuousRecorder(const std::string &name,
+                     const std::filesystem::path &root, int segmentSeconds);
+  ~ContinuousRecorder();
+
+  // Called from the appsink streaming thread; takes ownership of sample
+  void pushSample(GstSample *sample);
+  void stop(); // Flushes and closes the current file
+
+  RecordingStats stats() const;
+
+  // Called with each file once it is closed. Set before the first sample.
+  void setOnFileClosed(std::function<void(const std::filesystem::path &)> fn) {
+    onFileClosed_ = std::move(fn);
+  }
+
+  // Latest keyframe at or before the given time, from the index only
+  static bool seek(const std::filesystem::path &root,
+                   std::chrono::system_clock::time_point when,
+                   RecordingPosition &out);
+  static std::filesystem::path
+  hourDir(const std::filesystem::path &root,
+          std::chrono::system_clock::time_point when);
+
+private:
+  bool openFile(std::chrono::system_clock::time_point when);
+  void closeFile();
+  void appendIndex(int64_t wallMs);
+  // False if pts cannot be mapped through the current anchor
+  bool wallClockMs(GstClockTime pts, int64_t &wallMs) const;
+
+  std::string name_;
+  std::filesystem::path root_;
+  std::chrono::seconds segmentLength_;
+
+  mutable std::mutex mutex_;
+  std::FILE *data_ = nullptr;
+  std::FILE *index_ = nullptr;
+  std::filesystem::path dataPath_;
+  uint64_t offset_ = 0;
+  uint32_t fileSecond_ = 0; // Seconds into the hour, names the file
+  int64_t fileHour_ = -1;   // Hours since the epoch of the open file
+  std::chrono::system_clock::time_point fileOpened_;
+
+  // Stream time -> wall clock, re-anchored whenever a file is opened so
+  // camera clock drift never accumulates past one file
+  int64_t anchorWallMs_ = 0;
+  GstClockTime anchorPts_ = GST_CLOCK_TIME_NONE;
+  int64_t lastIndexedMs_ = 0;
+  // Mapped keyframe time this far off the wall clock is a discontinuity
+  static constexpr int64_t kMaxPtsDriftMs = 5000;
+
+  uint64_t bytesWritten_ = 0;
+  uint64_t filesWritten_ = 0;
+  uint64_t keyframesIndexed_ = 0;
+  std::function<void(const std::filesystem::path &)> onFileClosed_;
+};
@@ -17,6 +17,37 @@ struct SettingsDefaults {
   float motion_arrow_scale_ = 2.5f;
   int motion_arrow_thickness_ = 1;
   float motion_frame_scale_ = 1.0f;
+  int motion_fps_ = 10;
+  std::string motion_decode_mode_ = "full";
+  int feature_redetect_interval_ = 10;
+  float feature_min_survivor_ratio_ = 0.5f;
+  float diff_gate_ratio_ = 0.002f;
+  int diff_gate_pixel_threshold_ = 12;
+  int motion_view_timeout_seconds_ = 10;
+  int motion_stream_max_clients_ = 4;
+  std::string motion_engine_ = "optical_flow";
+  int frame_diff_pixel_threshold_ = 25;
+  int bg_subtractor_history_ = 500;
+  float bg_subtractor_var_threshold_ = 16.0f;
+  float mv_fallback_band_ = 0.25f;
+  float mv_fallback_intra_ratio_ = 0.5f;
   std::string video_output_format_ = "mkv";
   int live_rtsp_proxy_port_ = 8554;
+  int motion_worker_threads_ = 0; // 0 = half the hardware threads
+  int export_workers_ = 1;
+  int export_queue_limit_ = 32;
+  int preroll_seconds_ = 5;
+  int preroll_max_mb_ = 32;
+  int record_segment_seconds_ = 300;
+  // Retention quotas, 0 = unlimited
+  double retention_max_gb_ = 0.0;
+  int retention_max_days_ = 0;
+  double retention_camera_max_gb_ = 0.0;
+  int retention_camera_max_days_ = 0;
+  int retention_interval_seconds_ = 60;
+  int camera_startup_threads_ = 4;
+  int stream_probe_ttl_seconds_ = 600;
+  int stream_stall_seconds_ = 10;
+  int reconnect_backoff_min_seconds_ = 1;
+  int reconnect_backoff_max_seconds_ = 60;
 };
@@ -0,0 +1,178 @@
+#include "ExportScheduler.h"
+#include "VideoExporter.h"
+#include <algorithm>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+ExportScheduler::ExportScheduler(int workers, size_t queueLimit)
+    : queueLimit_(std::max<size_t>(1, queueLimit)) {
+  workers = std::max(1, workers);
+  for (int i = 0; i < workers; ++i)
+    workers_.push_back(std::make_unique<Worker>());
+}
+
+ExportScheduler::~ExportScheduler() { stop(); }
+
+void ExportScheduler::start() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (running_)
+      return;
+    running_ = true;
+  }
+
+  for (size_t i = 0; i < workers_.size(); ++i)
+    workers_[i]->thread = std::thread(&ExportScheduler::workerLoop, this, i);
+
+  std::cout << "[ExportScheduler] Started " << workers_.size()
+            << " workers (queue limit " << queueLimit_ << ")." << std::endl;
+}
+
+void ExportScheduler::stop() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (!running_)
+      return;
+    running_ = false;
+  }
+  cv_.notify_all();
+
+  // Workers keep going until the queue is empty so no clip is lost
+  for (auto &w : workers_) {
+    if (w->thread.joinable())
+      w->thread.join();
+  }
+
+  std::cout << "[ExportScheduler] Stopped." << std::endl;
+}
+
+bool ExportScheduler::submit(ExportJob job) {
+  std::string camera = job.camera;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (!running_ || queued_ >= queueLimit_) {
+      rejected_++;
+      return false;
+    }
+
+    auto &q = queues_[camera];
+    if (q.empty())
+      turns_.push_back(camera);
+    q.push_back(Pending{std::move(job), std::chrono::steady_clock::now()});
+    queued_++;
+    submitted_++;
+  }
+  cv_.notify_one();
+  return true;
+}
+
+bool ExportScheduler::takeLocked(Pending &out) {
+  if (turns_.empty())
+    return false;
+
+  // Round-robin over cameras; a camera with more work goes to the back
+  std::string camera = std::move(turns_.front());
+  turns_.pop_front();
+
+  auto it = queues_.find(camera);
+  out = std::move(it->second.front());
+  it->second.pop_front();
+  queued_--;
+
+  if (it->second.empty())
+    queues_.erase(it);
+  else
+    turns_.push_back(std::move(camera));
+  return true;
+}
+
+void ExportScheduler::workerLoop(size_t index) {
+  Worker &w = *workers_[index];
+
+  while (true) {
+    Pending p;
+    {
+      std::unique_lock<std::mutex> lk(mutex_);
+      cv_.wait(lk, [this] { return !running_ || queued_ > 0; });
+      if (!takeLocked(p))
+        break; // Stopped and drained
+
+      double waitMs = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - p.queuedAt)
+                          .count();
+      started_++;
+      totalWaitMs_ += waitMs;
+      maxWaitMs_ = std::max(maxWaitMs_, waitMs);
+      w.busy = true;
+      w.current = p.job.camera;
+    }
+
+    uint64_t bytes = 0;
+    for (const auto &seg : p.job.segments) {
+      std::error_code ec;
+      auto sz = fs::file_size(seg, ec);
+      if (!ec)
+        bytes += sz;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    fs::path written;
+    bool ok = VideoExporter::exportSegments(p.job.segments, p.job.outputFolder,
+                                            p.job.outputFilename, &written);
+    double secs = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - t0)
+                      .count();
+
+    if (ok) {
+      std::cout << "[ExportScheduler] Export completed: "
+                << p.job.outputFilename << " (" << p.job.camera << ")"
+                << std::endl;
+      if (onExported_)
+        onExported_(written);
+    } else {
+      std::cerr << "[ExportScheduler] Export failed for "
+                << p.job.outputFilename << " (" << p.job.camera << ")"
+                << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lk(mutex_);
+    w.busy = false;
+    w.current.clear();
+    busySeconds_ += secs;
+    if (ok) {
+      completed_++;
+      bytesExported_ += bytes;
+    } else {
+      failed_++;
+    }
+  }
+}
+
+ExportStats ExportScheduler::stats() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  ExportStats st;
+  st.workers = static_cast<int>(workers_.size());
+  st.queue_limit = queueLimit_;
+  st.queue_depth = queued_;
+  for (const auto &w : workers_)
+    st.running += w->busy ? 1 : 0;
+  st.submitted = submitted_;
+  st.completed = completed_;
+  st.failed = failed_;
+  st.rejected = rejected_;
+  st.avg_wait_ms = started_ ? totalWaitMs_ / started_ : 0.0;
+  st.max_wait_ms = maxWaitMs_;
+  st.bytes_exported = bytesExported_;
+  st.bytes_per_sec = busySeconds_ > 0.0 ? bytesExported_ / busySeconds_ : 0.0;
+  return st;
+}
+
+std::vector<ExportWorkerStats> ExportScheduler::workerStats() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  std::vector<ExportWorkerStats> out;
+  out.reserve(workers_.size());
+  for (const auto &w : workers_)
+    out.push_back(ExportWorkerStats{w->busy, w->current});
+  return out;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One motion clip to assemble from retained segments
+struct ExportJob {
+  std::string camera;
+  std::vector<std::filesystem::path> segments;
+  std::filesystem::path outputFolder;
+  std::string outputFilename;
+};
+
+struct ExportStats {
+  int workers = 0;
+  size_t queue_limit = 0;
+  size_t queue_depth = 0;
+  size_t running = 0;
+  uint64_t submitted = 0;
+  uint64_t completed = 0;
+  uint64_t failed = 0;
+  uint64_t rejected = 0; // Queue was full
+  double avg_wait_ms = 0.0;
+  double max_wait_ms = 0.0;
+  uint64_t bytes_exported = 0;
+  double bytes_per_sec = 0.0; // Over time spent exporting, not wall time
+};
+
+struct ExportWorkerStats {
+  bool busy = false;
+  std::string current; // Camera being exported, empty when idle
+};
+
+// Fixed pool that assembles motion clips for all cameras. Jobs wait in
+// per-camera queues served round-robin, so one busy camera can't starve the
+// others, and the total number of queued jobs is bounded.
+class ExportScheduler {
+public:
+  // workers <= 0 means 1
+  explicit ExportScheduler(int workers = 1, size_t queueLimit = 32);
+  ~ExportScheduler();
+
+  void start();
+  // Runs whatever is still queued, then joins the workers
+  void stop();
+
+  // False if the queue is full or the scheduler isn't running
+  bool submit(ExportJob job);
+
+  // Called on a worker with each exported file. Must be set before start().
+  void setOnExported(std::function<void(const std::filesystem::path &)> fn) {
+    onExported_ = std::move(fn);
+  }
+
+  ExportStats stats() const;
+  std::vector<ExportWorkerStats> workerStats() const;
+
+private:
+  struct Pending {
+    ExportJob job;
+    std::chrono::steady_clock::time_point queuedAt;
+  };
+
+  struct Worker {
+    std::thread thread;
+    bool busy = false;   // Guarded by mutex_
+    std::string current; // Guarded by mutex_
+  };
+
+  void workerLoop(size_t index);
+  bool takeLocked(Pending &out);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  size_t queueLimit_;
+  bool running_ = false;
+  std::function<void(const std::filesystem::path &)> onExported_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::map<std::string, std::deque<Pending>> queues_;
+  std::deque<std::string> turns_; // Cameras with queued jobs, in serving order
+  size_t queued_ = 0;
+
+  // Metrics, guarded by mutex_
+  uint64_t submitted_ = 0;
+  uint64_t completed_ = 0;
+  uint64_t failed_ = 0;
+  uint64_t rejected_ = 0;
+  uint64_t started_ = 0;
+  double totalWaitMs_ = 0.0;
+  double maxWaitMs_ = 0.0;
+  uint64_t bytesExported_ = 0;
+  double busySeconds_ = 0.0;
+};
@@ -0,0 +1,225 @@
+#include "GstRuntime.h"
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#ifndef _WIN32
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace {
+
+// CPU time of the calling thread. Windows falls back to wall time, which
+// over-charges a callback that blocks but keeps the relative picture.
+int64_t threadCpuNs() {
+#ifdef _WIN32
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#else
+  timespec ts{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+struct Invocation {
+  const std::function<void()> *fn = nullptr;
+  std::mutex m;
+  std::condition_variable cv;
+  bool done = false;
+};
+
+gboolean onInvoke(gpointer data) {
+  auto *inv = static_cast<Invocation *>(data);
+  (*inv->fn)();
+  std::lock_guard<std::mutex> lk(inv->m);
+  inv->done = true;
+  inv->cv.notify_one();
+  return G_SOURCE_REMOVE;
+}
+
+} // namespace
+
+struct GstRuntime::Watch {
+  GstRuntime *runtime = nullptr;
+  std::string owner;
+  std::function<void(GstMessage *)> fn;
+};
+
+GstRuntime::GstRuntime() {
+  context_ = g_main_context_new();
+  loop_ = g_main_loop_new(context_, FALSE);
+}
+
+GstRuntime::~GstRuntime() {
+  stop();
+  g_main_loop_unref(loop_);
+  g_main_context_unref(context_);
+}
+
+void GstRuntime::start() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (running_)
+    return;
+  running_ = true;
+  thread_ = std::thread([this] {
+    g_main_context_push_thread_default(context_);
+    g_main_loop_run(loop_);
+    g_main_context_pop_thread_default(context_);
+  });
+  thread_id_ = thread_.get_id();
+  std::cout << "[GstRuntime] Main context running." << std::endl;
+}
+
+void GstRuntime::stop() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (!running_)
+      return;
+    running_ = false;
+  }
+  // Quit from inside the loop: a quit issued before g_main_loop_run()
+  // started would be lost
+  g_main_context_invoke(
+      context_,
+      [](gpointer loop) {
+        g_main_loop_quit(static_cast<GMainLoop *>(loop));
+        return G_SOURCE_REMOVE;
+      },
+      loop_);
+  if (thread_.joinable())
+    thread_.join();
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    thread_id_ = std::thread::id();
+  }
+  std::cout << "[GstRuntime] Stopped." << std::endl;
+}
+
+bool GstRuntime::running() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return running_;
+}
+
+bool GstRuntime::onRuntimeThread() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return std::this_thread::get_id() == thread_id_;
+}
+
+gboolean GstRuntime::onBusMessage(GstBus * /*bus*/, GstMessage *msg,
+                                  gpointer data) {
+  auto *w = static_cast<Watch *>(data);
+  const int64_t t0 = threadCpuNs();
+  w->fn(msg);
+  w->runtime->charge(w->owner, threadCpuNs() - t0);
+  return G_SOURCE_CONTINUE;
+}
+
+GSource *GstRuntime::addBusWatch(GstBus *bus, const std::string &owner,
+                                 std::function<void(GstMessage *)> fn) {
+  GSource *source = gst_bus_create_watch(bus);
+  if (!source)
+    return nullptr;
+  auto *w = new Watch{this, owner, std::move(fn)};
+  g_source_set_callback(source, (GSourceFunc)onBusMessage, w,
+                        [](gpointer p) { delete static_cast<Watch *>(p); });
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    owners_[owner].owner = owner;
+    sources_++;
+  }
+  g_source_attach(source, context_);
+  return source; // Our reference; remove() drops it
+}
+
+void GstRuntime::attach(GSource *source) {
+  if (!source)
+    return;
+  g_source_ref(source);
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    sources_++;
+  }
+  g_source_attach(source, context_);
+}
+
+void GstRuntime::remove(GSource *source) {
+  if (!source)
+    return;
+  g_source_destroy(source);
+  // Dispatches are serialized on the runtime thread: once an empty
+  // invocation has run there, no callback of this source is still running
+  if (!onRuntimeThread())
+    invokeSync([] {});
+  g_source_unref(source);
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (sources_ > 0)
+    sources_--;
+}
+
+void GstRuntime::invokeSync(const std::function<void()> &fn) {
+  if (onRuntimeThread() || !running()) {
+    fn();
+    return;
+  }
+  Invocation inv;
+  inv.fn = &fn;
+  GSource *idle = g_idle_source_new();
+  g_source_set_priority(idle, G_PRIORITY_HIGH);
+  g_source_set_callback(idle, onInvoke, &inv, nullptr);
+  g_source_attach(idle, context_);
+  g_source_unref(idle);
+
+  std::unique_lock<std::mutex> lk(inv.m);
+  inv.cv.wait(lk, [&] { return inv.done; });
+}
+
+void GstRuntime::charge(const std::string &owner, int64_t cpuNs) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  GstRuntimeOwnerStats &st = owners_[owner];
+  st.dispatches++;
+  st.cpu_ms += cpuNs / 1e6;
+}
+
+std::vector<GstRuntimeOwnerStats> GstRuntime::ownerStats() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  std::vector<GstRuntimeOwnerStats> out;
+  out.reserve(owners_.size());
+  for (const auto &[name, st] : owners_)
+    out.push_back(st);
+  return out;
+}
+
+GstRuntimeOwnerStats GstRuntime::ownerStats(const std::string &owner) const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  auto it = owners_.find(owner);
+  if (it != owners_.end())
+    return it->second;
+  GstRuntimeOwnerStats st;
+  st.owner = owner;
+  return st;
+}
+
+double GstRuntime::threadCpuMs() const {
+#ifdef _WIN32
+  return 0.0;
+#else
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (!running_)
+    return 0.0;
+  clockid_t cid;
+  if (pthread_getcpuclockid(
+          const_cast<std::thread &>(thread_).native_handle(), &cid) != 0)
+    return 0.0;
+  timespec ts{};
+  if (clock_gettime(cid, &ts) != 0)
+    return 0.0;
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+#endif
+}
+
+size_t GstRuntime::sourceCount() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return sources_;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gst/gst.h>
+
+struct GstRuntimeOwnerStats {
+  std::string owner;
+  uint64_t dispatches = 0;
+  double cpu_ms = 0.0; // Thread CPU time spent in the owner's callbacks
+};
+
+// One GLib main context and the thread that runs it, shared by everything
+// in the server that needs a main loop: camera bus watches and the RTSP
+// proxy server. Adding cameras adds sources to this context, not threads.
+//
+// Sources added through addBusWatch() are tagged with an owner (the camera
+// name) and the CPU time their callbacks take is charged to it.
+class GstRuntime {
+public:
+  GstRuntime();
+  ~GstRuntime();
+
+  void start();
+  void stop();
+  bool running() const;
+  GMainContext *context() const { return context_; }
+
+  // fn runs on the runtime thread for every message that reaches the bus
+  // queue (i.e. wasn't dropped by a sync handler). Remove with remove().
+  GSource *addBusWatch(GstBus *bus, const std::string &owner,
+                       std::function<void(GstMessage *)> fn);
+  // Attaches a source created elsewhere (e.g. the RTSP server's); takes a
+  // reference, dropped by remove()
+  void attach(GSource *source);
+  // Destroys the source and waits for a callback of it in progress
+  void remove(GSource *source);
+
+  // Runs fn on the runtime thread and waits for it (inline when already
+  // there, or when the runtime isn't running)
+  void invokeSync(const std::function<void()> &fn);
+
+  std::vector<GstRuntimeOwnerStats> ownerStats() const;
+  GstRuntimeOwnerStats ownerStats(const std::string &owner) const;
+  double threadCpuMs() const; // Whole runtime thread, 0 if unsupported
+  size_t sourceCount() const;
+
+private:
+  struct Watch;
+  static gboolean onBusMessage(GstBus *bus, GstMessage *msg, gpointer data);
+  void charge(const std::string &owner, int64_t cpuNs);
+  bool onRuntimeThread() const;
+
+  GMainContext *context_ = nullptr;
+  GMainLoop *loop_ = nullptr;
+  std::thread thread_;
+  std::thread::id thread_id_;
+
+  mutable std::mutex mutex_;
+  bool running_ = false;
+  size_t sources_ = 0;
+  std::map<std::string, GstRuntimeOwnerStats> owners_;
+};
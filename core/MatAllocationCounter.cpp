@@ -0,0 +1,57 @@
+#include "MatAllocationCounter.h"
+#include <mutex>
+#include <opencv2/core.hpp>
+
+namespace {
+
+thread_local uint64_t t_allocations = 0;
+
+class CountingAllocator : public cv::MatAllocator {
+public:
+  explicit CountingAllocator(cv::MatAllocator *base) : base_(base) {}
+
+#if CV_VERSION_MAJOR >= 4
+  cv::UMatData *allocate(int dims, const int *sizes, int type, void *data,
+                         size_t *step, cv::AccessFlag flags,
+                         cv::UMatUsageFlags usageFlags) const override {
+    ++t_allocations;
+    return base_->allocate(dims, sizes, type, data, step, flags, usageFlags);
+  }
+  bool allocate(cv::UMatData *data, cv::AccessFlag accessflags,
+                cv::UMatUsageFlags usageFlags) const override {
+    return base_->allocate(data, accessflags, usageFlags);
+  }
+#else
+  cv::UMatData *allocate(int dims, const int *sizes, int type, void *data,
+                         size_t *step, int flags,
+                         cv::UMatUsageFlags usageFlags) const override {
+    ++t_allocations;
+    return base_->allocate(dims, sizes, type, data, step, flags, usageFlags);
+  }
+  bool allocate(cv::UMatData *data, int accessflags,
+                cv::UMatUsageFlags usageFlags) const override {
+    return base_->allocate(data, accessflags, usageFlags);
+  }
+#endif
+  // Buffers record the wrapped allocator as their owner, so this only runs
+  // for data that never came from allocate() above
+  void deallocate(cv::UMatData *data) const override {
+    base_->deallocate(data);
+  }
+
+private:
+  cv::MatAllocator *base_;
+};
+
+} // namespace
+
+void MatAllocationCounter::install() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    // Never freed: Mats may be created until the process exits
+    cv::Mat::setDefaultAllocator(
+        new CountingAllocator(cv::Mat::getDefaultAllocator()));
+  });
+}
+
+uint64_t MatAllocationCounter::thisThread() { return t_allocations; }
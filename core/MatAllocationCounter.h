@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts cv::Mat buffer allocations per thread. install() wraps OpenCV's
+// default allocator once per process; every Mat created afterwards goes
+// through it. Only the allocation is intercepted, buffers are freed by the
+// wrapped allocator as before.
+//
+// The motion loop samples thisThread() around a frame to report how many
+// frame buffers it had to allocate.
+class MatAllocationCounter {
+public:
+  static void install();
+  static uint64_t thisThread();
+};
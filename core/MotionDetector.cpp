@@ -0,0 +1,368 @@
+#include "MotionDetector.h"
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video.hpp>
+#include <utility>
+
+const char *motionEngineToString(MotionEngine engine) {
+  switch (engine) {
+  case MotionEngine::BackgroundSubtraction:
+    return "bg_subtract";
+  case MotionEngine::FrameDiff:
+    return "frame_diff";
+  case MotionEngine::MotionVectors:
+    return "motion_vectors";
+  case MotionEngine::OpticalFlow:
+  default:
+    return "optical_flow";
+  }
+}
+
+MotionEngine motionEngineFromString(const std::string &s) {
+  if (s == "bg_subtract")
+    return MotionEngine::BackgroundSubtraction;
+  if (s == "frame_diff")
+    return MotionEngine::FrameDiff;
+  if (s == "motion_vectors")
+    return MotionEngine::MotionVectors;
+  return MotionEngine::OpticalFlow;
+}
+
+namespace {
+
+// Sparse Lucas-Kanade flow on corners tracked from frame to frame. Scores
+// the average displacement of the points that moved more than the noise
+// threshold.
+class OpticalFlowDetector : public MotionDetector {
+public:
+  MotionEngine engine() const override { return MotionEngine::OpticalFlow; }
+  void analyze(const MotionDetectorInput &in,
+               MotionDetectorResult &result) override;
+  // The gated frame has no pyramid; rebuild the previous one next time
+  void skipped() override { prevPyrValid_ = false; }
+  void reset() override {
+    trackedPts_.clear();
+    prevPyrValid_ = false;
+  }
+
+private:
+  static constexpr int kMaxFeatures = 100;
+  // Pyramids are built with the same window/levels calcOpticalFlowPyrLK
+  // uses by default
+  static constexpr int kLevels = 3;
+  const cv::Size window_{21, 21};
+
+  // Each frame's pyramid is built once and reused as the previous one
+  // next frame
+  std::vector<cv::Mat> pyr_, prevPyr_;
+  bool prevPyrValid_ = false;
+
+  // Feature points carried forward between frames (in prevGray coords)
+  std::vector<cv::Point2f> trackedPts_;
+  std::vector<cv::Point2f> nextPts_;
+  std::vector<uchar> status_;
+  std::vector<float> err_;
+  size_t detectedCount_ = 0;
+  int framesSinceDetect_ = 0;
+};
+
+void OpticalFlowDetector::analyze(const MotionDetectorInput &in,
+                                  MotionDetectorResult &result) {
+  result.motion = 0.0f;
+  result.regionScore.assign(in.regionArea.size(), 0.0f);
+  result.regionPoints.assign(in.regionArea.size(), 0);
+  result.vectors.clear();
+  result.foreground.release();
+
+  // Only re-detect when the tracked set has thinned out or the refresh
+  // interval has elapsed; otherwise keep tracking survivors
+  bool redetect = trackedPts_.empty() ||
+                  framesSinceDetect_ >= in.redetectInterval ||
+                  trackedPts_.size() < detectedCount_ * in.minSurvivorRatio;
+  if (redetect) {
+    trackedPts_.reserve(kMaxFeatures);
+    trackedPts_.clear();
+    cv::goodFeaturesToTrack(in.prevGray, trackedPts_, kMaxFeatures, 0.01, 10,
+                            in.regionMask);
+    detectedCount_ = trackedPts_.size();
+    framesSinceDetect_ = 0;
+  }
+  ++framesSinceDetect_;
+
+  if (trackedPts_.empty()) {
+    prevPyrValid_ = false;
+    return;
+  }
+
+  if (!prevPyrValid_)
+    cv::buildOpticalFlowPyramid(in.prevGray, prevPyr_, window_, kLevels);
+  cv::buildOpticalFlowPyramid(in.gray, pyr_, window_, kLevels);
+
+  nextPts_.reserve(kMaxFeatures);
+  status_.reserve(kMaxFeatures);
+  err_.reserve(kMaxFeatures);
+  // Calculate optical flow between previous and current gray frames
+  cv::calcOpticalFlowPyrLK(prevPyr_, pyr_, trackedPts_, nextPts_, status_,
+                           err_, window_, kLevels);
+
+  float totalMotion = 0;
+  int validCount = 0;
+  for (size_t i = 0; i < trackedPts_.size(); ++i) {
+    if (!status_[i])
+      continue;
+
+    // Region slot under the point: one byte load. Without regions the
+    // whole frame counts; with them, 0 means outside.
+    int slot = -1;
+    if (!in.regionMask.empty()) {
+      const cv::Point p(trackedPts_[i]);
+      if (p.x < 0 || p.y < 0 || p.x >= in.regionMask.cols ||
+          p.y >= in.regionMask.rows)
+        continue;
+      slot = in.regionMask.at<uchar>(p);
+      if (slot == 0)
+        continue;
+      --slot;
+    }
+
+    float dist = cv::norm(nextPts_[i] - trackedPts_[i]);
+    if (dist > in.noiseThreshold) { // Filter out noise
+      totalMotion += dist;
+      validCount++;
+      if (slot >= 0) {
+        result.regionScore[slot] += dist;
+        result.regionPoints[slot]++;
+      }
+      if (in.render)
+        result.vectors.push_back({trackedPts_[i], nextPts_[i]});
+    }
+  }
+  for (size_t i = 0; i < result.regionScore.size(); ++i) {
+    if (result.regionPoints[i])
+      result.regionScore[i] /= result.regionPoints[i];
+  }
+  if (validCount > 0)
+    result.motion = totalMotion / validCount;
+
+  // Survivors become the next frame's previous points
+  size_t kept = 0;
+  const cv::Rect frameRect(0, 0, in.gray.cols, in.gray.rows);
+  for (size_t i = 0; i < nextPts_.size(); ++i) {
+    if (status_[i] && frameRect.contains(cv::Point2i(nextPts_[i])))
+      nextPts_[kept++] = nextPts_[i];
+  }
+  nextPts_.resize(kept);
+  trackedPts_.swap(nextPts_); // Both keep their capacity
+
+  std::swap(pyr_, prevPyr_);
+  prevPyrValid_ = true;
+}
+
+// Base of the engines that classify every pixel as moving or not. A 3x3
+// opening removes isolated specks (foliage, sensor noise) from the raw
+// mask; the score is the share of pixels left, per region and overall.
+class PixelMotionDetector : public MotionDetector {
+protected:
+  void score(const cv::Mat &raw, const MotionDetectorInput &in,
+             MotionDetectorResult &result);
+
+private:
+  const cv::Mat kernel_ =
+      cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+  cv::Mat mask_;
+};
+
+void PixelMotionDetector::score(const cv::Mat &raw,
+                                const MotionDetectorInput &in,
+                                MotionDetectorResult &result) {
+  cv::morphologyEx(raw, mask_, cv::MORPH_OPEN, kernel_);
+
+  const size_t slots = in.regionArea.size();
+  result.regionScore.assign(slots, 0.0f);
+  result.regionPoints.assign(slots, 0);
+  result.vectors.clear();
+  result.foreground = in.render ? mask_ : cv::Mat();
+
+  if (in.regionMask.empty()) {
+    const int moving = cv::countNonZero(mask_);
+    result.motion = mask_.total() ? 100.0f * moving / mask_.total() : 0.0f;
+    return;
+  }
+
+  // Tally moving pixels by the region slot under them
+  for (int y = 0; y < mask_.rows; ++y) {
+    const uchar *fg = mask_.ptr<uchar>(y);
+    const uchar *region = in.regionMask.ptr<uchar>(y);
+    for (int x = 0; x < mask_.cols; ++x) {
+      if (fg[x] && region[x])
+        ++result.regionPoints[region[x] - 1];
+    }
+  }
+
+  long moving = 0, area = 0;
+  for (size_t i = 0; i < slots; ++i) {
+    moving += result.regionPoints[i];
+    area += in.regionArea[i];
+    if (in.regionArea[i] > 0)
+      result.regionScore[i] =
+          100.0f * result.regionPoints[i] / in.regionArea[i];
+  }
+  result.motion = area ? 100.0f * moving / area : 0.0f;
+}
+
+// Absolute difference to the previous frame, thresholded per pixel.
+// Cheapest engine; sees anything that changed, including lighting.
+class FrameDiffDetector : public PixelMotionDetector {
+public:
+  explicit FrameDiffDetector(int pixelThreshold)
+      : pixelThreshold_(pixelThreshold) {}
+
+  MotionEngine engine() const override { return MotionEngine::FrameDiff; }
+  void analyze(const MotionDetectorInput &in,
+               MotionDetectorResult &result) override {
+    cv::absdiff(in.prevGray, in.gray, diff_);
+    cv::threshold(diff_, diff_, pixelThreshold_, 255, cv::THRESH_BINARY);
+    score(diff_, in, result);
+  }
+
+private:
+  int pixelThreshold_;
+  cv::Mat diff_;
+};
+
+// MOG2 per-pixel background model. Learns swaying branches and flicker
+// into the background over its history, at a higher cost per pixel.
+class BackgroundSubtractionDetector : public PixelMotionDetector {
+public:
+  BackgroundSubtractionDetector(int history, float varThreshold)
+      : model_(cv::createBackgroundSubtractorMOG2(history, varThreshold,
+                                                  /*detectShadows=*/false)) {}
+
+  MotionEngine engine() const override {
+    return MotionEngine::BackgroundSubtraction;
+  }
+  // MOG2 restarts its model by itself when the frame size changes
+  void analyze(const MotionDetectorInput &in,
+               MotionDetectorResult &result) override {
+    model_->apply(in.gray, foreground_);
+    score(foreground_, in, result);
+  }
+
+private:
+  cv::Ptr<cv::BackgroundSubtractorMOG2> model_;
+  cv::Mat foreground_;
+};
+
+// Scores the motion vectors the encoder already put in the H.264 stream,
+// with no pixel-domain flow: blocks that moved more than the noise
+// threshold count like tracked corners do for optical flow, so the score
+// (average displacement, px) and motion_threshold keep their meaning.
+// When the score lies within a band around the threshold, or much of the
+// frame is intra coded (vectors say little), optical flow on the decoded
+// luma decides instead, if the caller passed frames.
+class MotionVectorDetector : public MotionDetector {
+public:
+  MotionVectorDetector(float fallbackBand, float fallbackIntraRatio)
+      : fallbackBand_(fallbackBand), fallbackIntraRatio_(fallbackIntraRatio) {
+  }
+
+  MotionEngine engine() const override { return MotionEngine::MotionVectors; }
+  void analyze(const MotionDetectorInput &in,
+               MotionDetectorResult &result) override;
+  void skipped() override { fallback_.reset(); }
+  void reset() override { fallback_.reset(); }
+
+private:
+  bool ambiguous(const MotionDetectorInput &in, float score) const;
+
+  float fallbackBand_;       // Fraction of motion_threshold, 0 = never
+  float fallbackIntraRatio_; // Intra share that defers to the fallback
+  OpticalFlowDetector fallback_;
+};
+
+void MotionVectorDetector::analyze(const MotionDetectorInput &in,
+                                   MotionDetectorResult &result) {
+  result.motion = 0.0f;
+  result.fallback = false;
+  result.regionScore.assign(in.regionArea.size(), 0.0f);
+  result.regionPoints.assign(in.regionArea.size(), 0);
+  result.vectors.clear();
+  result.foreground.release();
+  if (!in.blockVectors)
+    return;
+
+  float totalMotion = 0;
+  int validCount = 0;
+  for (const MotionVector &v : *in.blockVectors) {
+    // Region slot under the block's position in this frame
+    int slot = -1;
+    if (!in.regionMask.empty()) {
+      const cv::Point p(v.to);
+      if (p.x < 0 || p.y < 0 || p.x >= in.regionMask.cols ||
+          p.y >= in.regionMask.rows)
+        continue;
+      slot = in.regionMask.at<uchar>(p);
+      if (slot == 0)
+        continue;
+      --slot;
+    }
+
+    float dist = cv::norm(v.to - v.from);
+    if (dist > in.noiseThreshold) {
+      totalMotion += dist;
+      validCount++;
+      if (slot >= 0) {
+        result.regionScore[slot] += dist;
+        result.regionPoints[slot]++;
+      }
+      if (in.render)
+        result.vectors.push_back(v);
+    }
+  }
+  for (size_t i = 0; i < result.regionScore.size(); ++i) {
+    if (result.regionPoints[i])
+      result.regionScore[i] /= result.regionPoints[i];
+  }
+  if (validCount > 0)
+    result.motion = totalMotion / validCount;
+
+  if (!ambiguous(in, result.motion) || in.gray.empty() ||
+      in.prevGray.empty()) {
+    // Tracked points go stale while the fallback sits out
+    fallback_.reset();
+    return;
+  }
+  fallback_.analyze(in, result);
+  result.fallback = true;
+}
+
+bool MotionVectorDetector::ambiguous(const MotionDetectorInput &in,
+                                     float score) const {
+  if (in.intraRatio >= fallbackIntraRatio_)
+    return true;
+  if (fallbackBand_ <= 0.0f || in.motionThreshold <= 0.0f)
+    return false;
+  return std::abs(score - in.motionThreshold) <=
+         fallbackBand_ * in.motionThreshold;
+}
+
+} // namespace
+
+std::unique_ptr<MotionDetector>
+MotionDetector::create(MotionEngine engine, const Settings &settings) {
+  switch (engine) {
+  case MotionEngine::BackgroundSubtraction:
+    return std::make_unique<BackgroundSubtractionDetector>(
+        settings.bg_subtractor_history(),
+        settings.bg_subtractor_var_threshold());
+  case MotionEngine::FrameDiff:
+    return std::make_unique<FrameDiffDetector>(
+        settings.frame_diff_pixel_threshold());
+  case MotionEngine::MotionVectors:
+    return std::make_unique<MotionVectorDetector>(
+        settings.mv_fallback_band(), settings.mv_fallback_intra_ratio());
+  case MotionEngine::OpticalFlow:
+  default:
+    return std::make_unique<OpticalFlowDetector>();
+  }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Settings.h"
+#include <memory>
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+// How a camera's motion loop scores motion between frames
+enum class MotionEngine {
+  OpticalFlow,           // Sparse Lucas-Kanade on tracked corners
+  BackgroundSubtraction, // MOG2 background model + morphology
+  FrameDiff,             // Difference to the previous frame + morphology
+  MotionVectors          // H.264 motion vectors, optical flow fallback
+};
+
+const char *motionEngineToString(MotionEngine engine);
+MotionEngine motionEngineFromString(const std::string &s);
+
+// A tracked point that moved more than the noise threshold, or an
+// inter-coded block (from = its position in the reference frame)
+struct MotionVector {
+  cv::Point2f from, to;
+};
+
+// One frame handed to a detector. All images and coordinates are at
+// analysis size, owned by the caller and valid for the duration of
+// analyze().
+struct MotionDetectorInput {
+  const cv::Mat &gray;     // Empty for motion vectors without a fallback
+  const cv::Mat &prevGray; // Previous frame, analyzed or gated
+  // Region slot + 1 per pixel, 0 = outside; empty = the whole frame counts
+  const cv::Mat &regionMask;
+  // Pixels per region slot, one entry per value used in regionMask; empty
+  // without regions
+  const std::vector<int> &regionArea;
+  float noiseThreshold;   // Optical flow: minimum displacement, px
+  int redetectInterval;   // Optical flow: frames between re-detection
+  float minSurvivorRatio; // Optical flow: re-detect below this ratio
+  bool render;            // Fill the overlay fields of the result
+  float motionThreshold = 0.0f; // Motion vectors: what "ambiguous" is near
+  // Motion vectors: the frame's inter-coded blocks, and the share of the
+  // frame coded without reference (intra), 0-1
+  const std::vector<MotionVector> *blockVectors = nullptr;
+  float intraRatio = 0.0f;
+};
+
+// What a detector found in one frame. Reused from frame to frame.
+struct MotionDetectorResult {
+  // Frame score compared against motion_threshold: average displacement
+  // in px for optical flow and motion vectors, percent of (region) pixels
+  // moving otherwise
+  float motion = 0.0f;
+  std::vector<float> regionScore; // Same unit, per region slot
+  std::vector<int> regionPoints;  // Moving points / pixels per slot
+  std::vector<MotionVector> vectors; // Optical flow, only when rendering
+  cv::Mat foreground; // Pixel engines: moving pixels, only when rendering
+  bool fallback = false; // Motion vectors: optical flow decided this frame
+};
+
+// A motion scoring engine. One instance per camera, only ever used from
+// that camera's motion loop, so implementations keep their history
+// (tracked points, pyramids, background model) without locking.
+class MotionDetector {
+public:
+  virtual ~MotionDetector() = default;
+
+  virtual MotionEngine engine() const = 0;
+  // Scores gray against the engine's history and updates it. The
+  // per-region vectors of result are sized to match regionArea.
+  virtual void analyze(const MotionDetectorInput &in,
+                       MotionDetectorResult &result) = 0;
+  // The pre-gate let this frame go without analysis
+  virtual void skipped() {}
+  // Frame size or regions changed: drop state tied to the old geometry
+  virtual void reset() {}
+
+  static std::unique_ptr<MotionDetector> create(MotionEngine engine,
+                                                const Settings &settings);
+};
@@ -0,0 +1,197 @@
+#include "MotionScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+MotionScheduler::MotionScheduler(int workers) {
+  if (workers <= 0)
+    workers = std::max(1u, std::thread::hardware_concurrency() / 2);
+
+  for (int i = 0; i < workers; ++i)
+    workers_.push_back(std::make_unique<Worker>());
+}
+
+MotionScheduler::~MotionScheduler() { stop(); }
+
+void MotionScheduler::start() {
+  if (running_.exchange(true))
+    return;
+
+  for (size_t i = 0; i < workers_.size(); ++i)
+    workers_[i]->thread = std::thread(&MotionScheduler::workerLoop, this, i);
+
+  std::cout << "[MotionScheduler] Started " << workers_.size() << " workers."
+            << std::endl;
+}
+
+void MotionScheduler::stop() {
+  if (!running_.exchange(false))
+    return;
+
+  {
+    std::lock_guard<std::mutex> lk(wake_mutex_);
+  }
+  wake_cv_.notify_all();
+
+  for (auto &w : workers_) {
+    if (w->thread.joinable())
+      w->thread.join();
+  }
+
+  // Anything still queued will never run; release waiters in removeStream()
+  {
+    std::lock_guard<std::mutex> lk(idle_mutex_);
+    for (auto &w : workers_) {
+      std::lock_guard<std::mutex> wl(w->mutex);
+      for (auto &s : w->queue)
+        s->scheduled.store(false);
+      w->queue.clear();
+    }
+    queued_ = 0;
+  }
+  idle_cv_.notify_all();
+
+  std::cout << "[MotionScheduler] Stopped." << std::endl;
+}
+
+MotionStreamHandle MotionScheduler::addStream(const std::string &name,
+                                              std::function<void()> drain) {
+  auto s = std::make_shared<MotionStreamEntry>();
+  s->name = name;
+  s->drain = std::move(drain);
+  s->home = next_home_.fetch_add(1) % workers_.size();
+  return s;
+}
+
+void MotionScheduler::removeStream(const MotionStreamHandle &stream) {
+  if (!stream)
+    return;
+
+  stream->removed.store(true);
+
+  std::unique_lock<std::mutex> lk(idle_mutex_);
+  idle_cv_.wait(lk, [&] { return !stream->scheduled.load(); });
+}
+
+void MotionScheduler::notify(const MotionStreamHandle &stream) {
+  if (stream->removed.load())
+    return;
+
+  stream->pending.store(true);
+
+  // Only one queue entry per stream: that's what keeps frames in order
+  bool expected = false;
+  if (stream->scheduled.compare_exchange_strong(expected, true))
+    enqueue(stream);
+}
+
+void MotionScheduler::enqueue(const MotionStreamHandle &stream) {
+  Worker &w = *workers_[stream->home];
+  {
+    std::lock_guard<std::mutex> lk(w.mutex);
+    w.queue.push_back(stream);
+  }
+  queued_++;
+
+  {
+    std::lock_guard<std::mutex> lk(wake_mutex_);
+  }
+  wake_cv_.notify_one();
+}
+
+MotionStreamHandle MotionScheduler::take(size_t index) {
+  // Own queue first (FIFO), then steal from the back of the others
+  {
+    Worker &own = *workers_[index];
+    std::lock_guard<std::mutex> lk(own.mutex);
+    if (!own.queue.empty()) {
+      MotionStreamHandle s = std::move(own.queue.front());
+      own.queue.pop_front();
+      queued_--;
+      return s;
+    }
+  }
+
+  for (size_t k = 1; k < workers_.size(); ++k) {
+    Worker &victim = *workers_[(index + k) % workers_.size()];
+    std::lock_guard<std::mutex> lk(victim.mutex);
+    if (!victim.queue.empty()) {
+      MotionStreamHandle s = std::move(victim.queue.back());
+      victim.queue.pop_back();
+      queued_--;
+      workers_[index]->steals++;
+      return s;
+    }
+  }
+
+  return nullptr;
+}
+
+void MotionScheduler::workerLoop(size_t index) {
+  Worker &w = *workers_[index];
+
+  while (running_) {
+    MotionStreamHandle s = take(index);
+    if (!s) {
+      std::unique_lock<std::mutex> lk(wake_mutex_);
+      wake_cv_.wait_for(lk, std::chrono::milliseconds(100),
+                        [this] { return !running_ || queued_.load() > 0; });
+      continue;
+    }
+    run(w, s);
+  }
+}
+
+void MotionScheduler::run(Worker &w, const MotionStreamHandle &stream) {
+  if (!stream->removed.load()) {
+    w.busy = true;
+    {
+      std::lock_guard<std::mutex> lk(w.mutex);
+      w.current = stream->name;
+    }
+
+    // One drain per turn; a busy camera goes to the back of the queue
+    // instead of monopolizing this worker
+    stream->pending.store(false);
+    stream->drain();
+    stream->runs++;
+    w.tasks_run++;
+
+    {
+      std::lock_guard<std::mutex> lk(w.mutex);
+      w.current.clear();
+    }
+    w.busy = false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(idle_mutex_);
+    stream->scheduled.store(false);
+  }
+  idle_cv_.notify_all();
+
+  // A notify() that raced with the drain saw scheduled == true and returned
+  // without queueing; pick that sample up now
+  if (stream->pending.load() && !stream->removed.load()) {
+    bool expected = false;
+    if (stream->scheduled.compare_exchange_strong(expected, true))
+      enqueue(stream);
+  }
+}
+
+std::vector<MotionWorkerStats> MotionScheduler::workerStats() const {
+  std::vector<MotionWorkerStats> out;
+  out.reserve(workers_.size());
+  for (const auto &w : workers_) {
+    MotionWorkerStats st;
+    st.busy = w->busy.load();
+    st.tasks_run = w->tasks_run.load();
+    st.steals = w->steals.load();
+    {
+      std::lock_guard<std::mutex> lk(w->mutex);
+      st.current = w->current;
+    }
+    out.push_back(std::move(st));
+  }
+  return out;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One registered motion source (a camera's appsink). The drain callback pulls
+// and analyzes whatever samples are ready; the scheduler guarantees it never
+// runs on two workers at once, so per-camera frame order is preserved.
+struct MotionStreamEntry {
+  std::string name;
+  std::function<void()> drain;
+  size_t home = 0; // Preferred worker (keeps a camera's state cache-warm)
+
+  std::atomic<bool> pending{false};   // New sample since last drain started
+  std::atomic<bool> scheduled{false}; // Queued or running on a worker
+  std::atomic<bool> removed{false};
+  std::atomic<uint64_t> runs{0};
+};
+
+using MotionStreamHandle = std::shared_ptr<MotionStreamEntry>;
+
+struct MotionWorkerStats {
+  bool busy = false;
+  uint64_t tasks_run = 0;
+  uint64_t steals = 0;
+  std::string current; // Camera being analyzed, empty when idle
+};
+
+// Fixed-size, work-stealing pool that runs motion analysis for all cameras.
+// Cameras call notify() from their appsink "new-sample" callback; a worker
+// then drains that camera's sink.
+class MotionScheduler {
+public:
+  // workers <= 0 picks half the hardware threads (at least 1)
+  explicit MotionScheduler(int workers = 0);
+  ~MotionScheduler();
+
+  void start();
+  void stop();
+
+  MotionStreamHandle addStream(const std::string &name,
+                               std::function<void()> drain);
+  // Blocks until the stream is neither queued nor running
+  void removeStream(const MotionStreamHandle &stream);
+  void notify(const MotionStreamHandle &stream);
+
+  size_t workerCount() const { return workers_.size(); }
+  std::vector<MotionWorkerStats> workerStats() const;
+
+private:
+  struct Worker {
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::deque<MotionStreamHandle> queue;
+    std::atomic<bool> busy{false};
+    std::atomic<uint64_t> tasks_run{0};
+    std::atomic<uint64_t> steals{0};
+    std::string current; // Guarded by mutex
+  };
+
+  void workerLoop(size_t index);
+  void enqueue(const MotionStreamHandle &stream);
+  MotionStreamHandle take(size_t index);
+  void run(Worker &w, const MotionStreamHandle &stream);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<bool> running_{false};
+  std::atomic<size_t> next_home_{0};
+
+  // Sleeping workers wait here; queued_ counts entries across all deques
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  std::atomic<size_t> queued_{0};
+
+  // removeStream() waits here for an in-flight drain to finish
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+};
@@ -0,0 +1,150 @@
+#include "MotionVectorDecoder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/motion_vector.h>
+}
+
+#include <algorithm>
+#include <iostream>
+
+MotionVectorDecoder::MotionVectorDecoder(const AVCodecParameters *par) {
+  const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+  if (!codec) {
+    std::cerr << "[MotionVectorDecoder] No H.264 decoder in libavcodec"
+              << std::endl;
+    return;
+  }
+  AVCodecContext *ctx = avcodec_alloc_context3(codec);
+  if (!ctx)
+    return;
+  if (par && avcodec_parameters_to_context(ctx, par) < 0) {
+    avcodec_free_context(&ctx);
+    return;
+  }
+
+#ifdef AV_CODEC_EXPORT_DATA_MVS
+  ctx->export_side_data |= AV_CODEC_EXPORT_DATA_MVS;
+#else
+  ctx->flags2 |= AV_CODEC_FLAG2_EXPORT_MVS;
+#endif
+  // The loop filter stays on: skipping it would let every P-frame predict
+  // from unfiltered references, and the luma (optical flow fallback,
+  // overlay) would drift into block artifacts that read as motion
+  // Cameras run in parallel on the motion pool, not frames in one decoder
+  ctx->thread_count = 1;
+
+  if (avcodec_open2(ctx, codec, nullptr) < 0) {
+    std::cerr << "[MotionVectorDecoder] Cannot open the H.264 decoder"
+              << std::endl;
+    avcodec_free_context(&ctx);
+    return;
+  }
+
+  avframe_ = av_frame_alloc();
+  received_ = av_frame_alloc();
+  packet_ = av_packet_alloc();
+  if (!avframe_ || !received_ || !packet_) {
+    avcodec_free_context(&ctx);
+    return;
+  }
+  ctx_ = ctx;
+}
+
+MotionVectorDecoder::~MotionVectorDecoder() {
+  frame_.luma.release(); // View into avframe_
+  av_packet_free(&packet_);
+  av_frame_free(&received_);
+  av_frame_free(&avframe_);
+  avcodec_free_context(&ctx_);
+}
+
+bool MotionVectorDecoder::decode(const uint8_t *data, size_t size,
+                                 int64_t pts) {
+  if (!ctx_ || !data || size == 0)
+    return false;
+
+  frame_.luma.release(); // View into avframe_, which is about to change
+
+  // The packet only borrows the data; send_packet copies what it keeps
+  packet_->data = const_cast<uint8_t *>(data);
+  packet_->size = static_cast<int>(size);
+  packet_->pts = pts;
+  bool got = false;
+  int err = avcodec_send_packet(ctx_, packet_);
+  if (err == AVERROR(EAGAIN)) {
+    // Output left waiting: take it and send the unit again, or every later
+    // frame in the GOP would miss this one as a reference
+    got = receiveFrames();
+    err = avcodec_send_packet(ctx_, packet_);
+  }
+  packet_->data = nullptr;
+  packet_->size = 0;
+  // err < 0 here is a corrupt unit; the decoder resyncs on its own
+
+  // A unit can release no frame (parameter sets, SEI, reordering delay) or
+  // several; drain them all so the next send is accepted
+  got = receiveFrames() || got;
+  if (!got)
+    return false;
+  exportFrame();
+  return true;
+}
+
+bool MotionVectorDecoder::receiveFrames() {
+  bool got = false;
+  while (avcodec_receive_frame(ctx_, received_) >= 0) {
+    av_frame_unref(avframe_);
+    av_frame_move_ref(avframe_, received_);
+    got = true;
+  }
+  return got;
+}
+
+void MotionVectorDecoder::exportFrame() {
+  MotionVectorFrame &f = frame_;
+  f.width = avframe_->width;
+  f.height = avframe_->height;
+  f.vectors.clear();
+  f.hasVectors = false;
+  f.intraRatio = 1.0f;
+
+  const AVFrameSideData *sd =
+      av_frame_get_side_data(avframe_, AV_FRAME_DATA_MOTION_VECTORS);
+  if (sd && avframe_->pict_type != AV_PICTURE_TYPE_I) {
+    const auto *mvs = reinterpret_cast<const AVMotionVector *>(sd->data);
+    const size_t count = sd->size / sizeof(AVMotionVector);
+    double covered = 0.0;
+    f.vectors.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      const AVMotionVector &mv = mvs[i];
+      // Bi-predicted blocks come twice; the past reference is enough
+      if (mv.source >= 0)
+        continue;
+      f.vectors.push_back({cv::Point2f(mv.src_x, mv.src_y),
+                           cv::Point2f(mv.dst_x, mv.dst_y)});
+      covered += double(mv.w) * mv.h;
+    }
+    const double area = double(f.width) * f.height;
+    f.hasVectors = true;
+    f.intraRatio =
+        area > 0 ? float(std::max(0.0, 1.0 - covered / area)) : 0.0f;
+  }
+
+  switch (avframe_->format) {
+  case AV_PIX_FMT_YUV420P:
+  case AV_PIX_FMT_YUVJ420P:
+  case AV_PIX_FMT_YUV422P:
+  case AV_PIX_FMT_YUVJ422P:
+  case AV_PIX_FMT_YUV444P:
+  case AV_PIX_FMT_YUVJ444P:
+  case AV_PIX_FMT_GRAY8:
+    f.luma = cv::Mat(f.height, f.width, CV_8UC1, avframe_->data[0],
+                     avframe_->linesize[0]);
+    break;
+  default:
+    f.luma.release();
+    break;
+  }
+}
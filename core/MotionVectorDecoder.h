@@ -0,0 +1,57 @@
+#pragma once
+
+#include "MotionDetector.h"
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <vector>
+
+struct AVCodecContext;
+struct AVCodecParameters;
+struct AVFrame;
+struct AVPacket;
+
+// One decoded frame as the motion vector engine sees it
+struct MotionVectorFrame {
+  int width = 0, height = 0;
+  // False for intra frames (keyframes), which have no vectors to score
+  bool hasVectors = false;
+  // Past-referenced blocks in frame coordinates: from = block center in
+  // the reference frame, to = block center in this frame
+  std::vector<MotionVector> vectors;
+  float intraRatio = 0.0f; // Share of the frame without a past reference
+  // Y plane of the decoded frame; a view valid until the next decode().
+  // Empty for pixel formats other than 8-bit YUV.
+  cv::Mat luma;
+};
+
+// Decodes H.264 with libavcodec and exports the encoder's per-block motion
+// vectors (AV_FRAME_DATA_MOTION_VECTORS side data). The stream is decoded
+// in full, deblocking included: every reference frame is needed, and the
+// luma must match the encoder's reconstruction for the optical flow
+// fallback.
+class MotionVectorDecoder {
+public:
+  // Annex B byte-stream input, or the stream's parameters (extradata) for
+  // avcC input from a demuxer
+  explicit MotionVectorDecoder(const AVCodecParameters *par = nullptr);
+  ~MotionVectorDecoder();
+  MotionVectorDecoder(const MotionVectorDecoder &) = delete;
+  MotionVectorDecoder &operator=(const MotionVectorDecoder &) = delete;
+
+  bool valid() const { return ctx_ != nullptr; }
+  // Feeds one access unit. True when it produced a frame, now in frame();
+  // if it released several, the newest.
+  bool decode(const uint8_t *data, size_t size, int64_t pts);
+  const MotionVectorFrame &frame() const { return frame_; }
+
+private:
+  bool receiveFrames(); // Drains the decoder into avframe_
+  void exportFrame();
+
+  AVCodecContext *ctx_ = nullptr;
+  AVFrame *avframe_ = nullptr;  // Newest decoded frame
+  AVFrame *received_ = nullptr; // Scratch for avcodec_receive_frame
+  AVPacket *packet_ = nullptr;
+  MotionVectorFrame frame_;
+};
@@ -0,0 +1,278 @@
+#include "PrerollRecorder.h"
+#include <algorithm>
+#include <gst/app/gstappsrc.h>
+#include <iostream>
+
+namespace {
+
+// Decode order timestamp, falling back to PTS
+GstClockTime sampleTime(GstSample *sample) {
+  GstBuffer *buf = gst_sample_get_buffer(sample);
+  if (!buf)
+    return GST_CLOCK_TIME_NONE;
+  return GST_BUFFER_DTS_IS_VALID(buf) ? GST_BUFFER_DTS(buf)
+                                      : GST_BUFFER_PTS(buf);
+}
+
+void unrefAll(std::vector<GstSample *> &samples) {
+  for (GstSample *s : samples)
+    gst_sample_unref(s);
+  samples.clear();
+}
+
+} // namespace
+
+PrerollRecorder::PrerollRecorder(const std::string &name, int prerollSeconds,
+                                 size_t maxBytes)
+    : name_(name),
+      preroll_(static_cast<GstClockTime>(std::max(0, prerollSeconds)) *
+               GST_SECOND),
+      maxBytes_(maxBytes) {}
+
+PrerollRecorder::~PrerollRecorder() { stop(); }
+
+void PrerollRecorder::start() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (running_)
+    return;
+  running_ = true;
+  writer_ = std::thread(&PrerollRecorder::writerLoop, this);
+}
+
+void PrerollRecorder::stop() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (!running_)
+      return;
+    if (recording_) {
+      recording_ = false;
+      enqueueLocked(Command{Command::Type::End, {}, {}});
+    }
+    running_ = false;
+  }
+  cv_.notify_all();
+  if (writer_.joinable())
+    writer_.join();
+
+  std::lock_guard<std::mutex> lk(mutex_);
+  for (auto &gop : gops_)
+    unrefAll(gop.samples);
+  gops_.clear();
+  bytes_ = 0;
+}
+
+void PrerollRecorder::pushSample(GstSample *sample) {
+  GstBuffer *buf = gst_sample_get_buffer(sample);
+  if (!buf) {
+    gst_sample_unref(sample);
+    return;
+  }
+  bool keyframe = !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+  size_t size = gst_buffer_get_size(buf);
+  GstClockTime ts = sampleTime(sample);
+
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (keyframe) {
+    Gop gop;
+    gop.start = ts;
+    gops_.push_back(std::move(gop));
+  }
+  if (gops_.empty()) {
+    // Nothing decodable until the first keyframe
+    gst_sample_unref(sample);
+    return;
+  }
+
+  if (recording_) {
+    Command cmd{Command::Type::Packet, {}, {gst_sample_ref(sample)}};
+    enqueueLocked(std::move(cmd));
+  }
+
+  gops_.back().samples.push_back(sample);
+  gops_.back().bytes += size;
+  bytes_ += size;
+  trimLocked(ts);
+}
+
+void PrerollRecorder::trimLocked(GstClockTime newest) {
+  // Drop whole GOPs from the front while the rest still covers the pre-roll
+  // window, or while over the byte budget. The newest GOP always stays.
+  while (gops_.size() > 1) {
+    const Gop &next = gops_[1];
+    bool covered = GST_CLOCK_TIME_IS_VALID(newest) &&
+                   GST_CLOCK_TIME_IS_VALID(next.start) &&
+                   newest >= next.start && newest - next.start >= preroll_;
+    if (!covered && bytes_ <= maxBytes_)
+      break;
+
+    bytes_ -= gops_.front().bytes;
+    unrefAll(gops_.front().samples);
+    gops_.pop_front();
+  }
+}
+
+void PrerollRecorder::beginClip(const std::string &path) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (!running_ || recording_)
+    return;
+  recording_ = true;
+
+  Command cmd{Command::Type::Begin, path, {}};
+  for (const auto &gop : gops_)
+    for (GstSample *s : gop.samples)
+      cmd.samples.push_back(gst_sample_ref(s));
+  enqueueLocked(std::move(cmd));
+}
+
+void PrerollRecorder::endClip() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (!recording_)
+    return;
+  recording_ = false;
+  enqueueLocked(Command{Command::Type::End, {}, {}});
+}
+
+void PrerollRecorder::enqueueLocked(Command cmd) {
+  commands_.push_back(std::move(cmd));
+  cv_.notify_one();
+}
+
+PrerollStats PrerollRecorder::stats() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  PrerollStats st;
+  st.buffered_bytes = bytes_;
+  st.gops = gops_.size();
+  st.recording = recording_;
+  st.clips_written = clipsWritten_;
+  if (!gops_.empty() && !gops_.back().samples.empty()) {
+    GstClockTime first = gops_.front().start;
+    GstClockTime last = sampleTime(gops_.back().samples.back());
+    if (GST_CLOCK_TIME_IS_VALID(first) && GST_CLOCK_TIME_IS_VALID(last) &&
+        last >= first)
+      st.buffered_ms = (last - first) / GST_MSECOND;
+  }
+  return st;
+}
+
+void PrerollRecorder::writerLoop() {
+  while (true) {
+    Command cmd;
+    {
+      std::unique_lock<std::mutex> lk(mutex_);
+      cv_.wait(lk, [this] { return !commands_.empty() || !running_; });
+      if (commands_.empty())
+        break; // Stopped and drained
+      cmd = std::move(commands_.front());
+      commands_.pop_front();
+    }
+
+    switch (cmd.type) {
+    case Command::Type::Begin:
+      if (!cmd.samples.empty() &&
+          openClip(cmd.path, gst_sample_get_caps(cmd.samples.front()))) {
+        for (GstSample *s : cmd.samples)
+          writeSample(s);
+      }
+      break;
+    case Command::Type::Packet:
+      if (clipPipeline_)
+        writeSample(cmd.samples.front());
+      break;
+    case Command::Type::End:
+      closeClip();
+      break;
+    }
+    unrefAll(cmd.samples);
+  }
+
+  closeClip();
+}
+
+bool PrerollRecorder::openClip(const std::string &path, GstCaps *caps) {
+  closeClip();
+
+  GError *error = nullptr;
+  clipPipeline_ = gst_parse_launch(
+      "appsrc name=src format=time ! h264parse ! matroskamux "
+      "! filesink name=sink",
+      &error);
+  if (!clipPipeline_) {
+    std::cerr << "[Preroll] " << name_ << ": failed to create clip pipeline: "
+              << (error ? error->message : "Unknown error") << std::endl;
+    if (error)
+      g_error_free(error);
+    return false;
+  }
+
+  clipSrc_ = gst_bin_get_by_name(GST_BIN(clipPipeline_), "src");
+  GstElement *sink = gst_bin_get_by_name(GST_BIN(clipPipeline_), "sink");
+  g_object_set(sink, "location", path.c_str(), nullptr);
+  gst_object_unref(sink);
+  if (caps)
+    gst_app_src_set_caps(GST_APP_SRC(clipSrc_), caps);
+
+  gst_element_set_state(clipPipeline_, GST_STATE_PLAYING);
+  clipBase_ = GST_CLOCK_TIME_NONE;
+  clipPath_ = path;
+
+  std::cout << "[Preroll] " << name_ << ": recording clip " << path
+            << std::endl;
+  return true;
+}
+
+void PrerollRecorder::writeSample(GstSample *sample) {
+  GstBuffer *in = gst_sample_get_buffer(sample);
+  if (!in || !clipSrc_)
+    return;
+
+  GstClockTime ts = sampleTime(sample);
+  if (!GST_CLOCK_TIME_IS_VALID(clipBase_))
+    clipBase_ = ts;
+
+  // Shallow copy: new metadata, same memory as the buffered access unit
+  GstBuffer *out = gst_buffer_copy(in);
+  auto rebase = [this](GstClockTime t) {
+    if (!GST_CLOCK_TIME_IS_VALID(t) || !GST_CLOCK_TIME_IS_VALID(clipBase_))
+      return t;
+    return t > clipBase_ ? t - clipBase_ : GstClockTime(0);
+  };
+  GST_BUFFER_PTS(out) = rebase(GST_BUFFER_PTS(in));
+  GST_BUFFER_DTS(out) = rebase(GST_BUFFER_DTS(in));
+
+  gst_app_src_push_buffer(GST_APP_SRC(clipSrc_), out);
+}
+
+void PrerollRecorder::closeClip() {
+  if (!clipPipeline_)
+    return;
+
+  // EOS lets matroskamux write its index before the file is closed
+  gst_app_src_end_of_stream(GST_APP_SRC(clipSrc_));
+  GstBus *bus = gst_element_get_bus(clipPipeline_);
+  GstMessage *msg = gst_bus_timed_pop_filtered(
+      bus, 10 * GST_SECOND,
+      static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  if (!msg || GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+    std::cerr << "[Preroll] " << name_ << ": clip " << clipPath_
+              << " may be incomplete" << std::endl;
+  } else {
+    std::lock_guard<std::mutex> lk(mutex_);
+    clipsWritten_++;
+  }
+  bool complete = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+  if (msg)
+    gst_message_unref(msg);
+  gst_object_unref(bus);
+
+  gst_element_set_state(clipPipeline_, GST_STATE_NULL);
+  gst_object_unref(clipSrc_);
+  gst_object_unref(clipPipeline_);
+  clipSrc_ = nullptr;
+  clipPipeline_ = nullptr;
+
+  std::cout << "[Preroll] " << name_ << ": closed clip " << clipPath_
+            << std::endl;
+  if (complete && onClipWritten_)
+    onClipWritten_(clipPath_); // filesink has closed the file
+  clipPath_.clear();
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <gst/gst.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct PrerollStats {
+  uint64_t buffered_ms = 0;
+  uint64_t buffered_bytes = 0;
+  size_t gops = 0;
+  bool recording = false;
+  uint64_t clips_written = 0;
+};
+
+// Keeps the last few seconds of encoded H.264 access units in memory, as
+// whole GOPs so the oldest entry is always a keyframe, and writes motion
+// clips from them: beginClip() flushes the buffered pre-roll into a new
+// Matroska file and every following access unit is appended until
+// endClip(). Nothing touches the disk while no clip is open.
+class PrerollRecorder {
+public:
+  PrerollRecorder(const std::string &name, int prerollSeconds,
+                  size_t maxBytes);
+  ~PrerollRecorder();
+
+  void start();
+  void stop(); // Closes an open clip and joins the writer
+
+  // Called from the appsink streaming thread; takes ownership of sample
+  void pushSample(GstSample *sample);
+
+  void beginClip(const std::string &path);
+  void endClip();
+
+  PrerollStats stats() const;
+
+  // Called on the writer thread with each completed clip. Set before start().
+  void setOnClipWritten(std::function<void(const std::string &)> fn) {
+    onClipWritten_ = std::move(fn);
+  }
+
+private:
+  struct Gop {
+    std::vector<GstSample *> samples;
+    size_t bytes = 0;
+    GstClockTime start = GST_CLOCK_TIME_NONE;
+  };
+
+  // Work for the writer thread, in stream order
+  struct Command {
+    enum class Type { Begin, Packet, End } type;
+    std::string path;                 // Begin
+    std::vector<GstSample *> samples; // Begin: pre-roll, Packet: one AU
+  };
+
+  void trimLocked(GstClockTime newest);
+  void enqueueLocked(Command cmd);
+  void writerLoop();
+
+  // Clip pipeline (writer thread only)
+  bool openClip(const std::string &path, GstCaps *caps);
+  void writeSample(GstSample *sample);
+  void closeClip();
+
+  std::string name_;
+  GstClockTime preroll_;
+  size_t maxBytes_;
+
+  mutable std::mutex mutex_;
+  std::deque<Gop> gops_;
+  size_t bytes_ = 0;
+  bool recording_ = false;
+
+  std::condition_variable cv_;
+  std::deque<Command> commands_;
+  bool running_ = false;
+  std::thread writer_;
+  uint64_t clipsWritten_ = 0;
+  std::function<void(const std::string &)> onClipWritten_;
+
+  GstElement *clipPipeline_ = nullptr;
+  GstElement *clipSrc_ = nullptr;
+  GstClockTime clipBase_ = GST_CLOCK_TIME_NONE;
+  std::string clipPath_;
+};
@@ -0,0 +1,300 @@
+#include "RetentionManager.h"
+#include <algorithm>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using SysClock = std::chrono::system_clock;
+
+SysClock::time_point toSystemTime(fs::file_time_type t) {
+  // file_time_type's clock has no portable conversion in C++17; go through
+  // the difference to "now" on both clocks
+  return SysClock::now() +
+         std::chrono::duration_cast<SysClock::duration>(
+             t - fs::file_time_type::clock::now());
+}
+
+bool isRecording(const fs::path &p) {
+  const auto ext = p.extension();
+  return ext == ".mkv" || ext == ".mp4" || ext == ".ts";
+}
+
+} // namespace
+
+RetentionManager::RetentionManager(const fs::path &mediaRoot,
+                                   RetentionPolicy global,
+                                   RetentionPolicy perCamera,
+                                   std::chrono::seconds interval)
+    : root_(mediaRoot), global_(global), perCamera_(perCamera),
+      interval_(std::max(std::chrono::seconds(1), interval)) {}
+
+RetentionManager::~RetentionManager() { stop(); }
+
+void RetentionManager::start() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (running_)
+    return;
+  running_ = true;
+  thread_ = std::thread(&RetentionManager::run, this);
+}
+
+void RetentionManager::stop() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (!running_)
+      return;
+    running_ = false;
+  }
+  cv_.notify_all();
+  if (thread_.joinable())
+    thread_.join();
+  std::cout << "[Retention] Stopped." << std::endl;
+}
+
+bool RetentionManager::running() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return running_;
+}
+
+void RetentionManager::add(const fs::path &file) {
+  std::string camera = cameraOf(file);
+  if (camera.empty())
+    return;
+
+  std::error_code ec;
+  uint64_t bytes = fs::file_size(file, ec);
+  if (ec)
+    return;
+
+  std::lock_guard<std::mutex> lk(mutex_);
+  addLocked(camera, Recording{SysClock::now(), file, bytes});
+  if (overQuotaLocked()) {
+    wake_ = true;
+    cv_.notify_one();
+  }
+}
+
+void RetentionManager::addLocked(const std::string &camera, Recording rec) {
+  CameraIndex &cam = cameras_[camera];
+  auto known = known_.find(rec.path);
+  if (known != known_.end()) {
+    // Already indexed: the startup scan can catch a file that is still
+    // being written, so keep the larger size (recordings only grow)
+    auto it = cam.files.find(Recording{known->second, rec.path});
+    if (it != cam.files.end() && rec.bytes > it->bytes) {
+      cam.bytes += rec.bytes - it->bytes;
+      totalBytes_ += rec.bytes - it->bytes;
+      Recording grown = *it;
+      grown.bytes = rec.bytes;
+      cam.files.insert(cam.files.erase(it), std::move(grown));
+    }
+    return;
+  }
+  known_.emplace(rec.path, rec.time);
+  cam.bytes += rec.bytes;
+  totalBytes_ += rec.bytes;
+  totalFiles_++;
+  cam.files.insert(std::move(rec));
+}
+
+std::string RetentionManager::cameraOf(const fs::path &file) const {
+  fs::path rel = file.lexically_relative(root_);
+  if (rel.empty() || *rel.begin() == "..")
+    return {};
+  return rel.begin()->string();
+}
+
+void RetentionManager::run() {
+  scanAll();
+
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (running_) {
+    lk.unlock();
+    enforce();
+    lk.lock();
+    cv_.wait_for(lk, interval_, [this] { return wake_ || !running_; });
+    wake_ = false;
+  }
+}
+
+void RetentionManager::scanAll() {
+  // The only directory walk: finished recordings already on disk
+  std::vector<std::pair<std::string, Recording>> found;
+  std::error_code ec;
+  for (const auto &camDir : fs::directory_iterator(root_, ec)) {
+    if (!camDir.is_directory())
+      continue;
+    const std::string camera = camDir.path().filename().string();
+
+    auto collect = [&](const fs::directory_entry &e) {
+      std::error_code fec;
+      if (!e.is_regular_file(fec) || !isRecording(e.path()))
+        return;
+      uint64_t bytes = e.file_size(fec);
+      auto mtime = e.last_write_time(fec);
+      if (!fec)
+        found.push_back(
+            {camera, Recording{toSystemTime(mtime), e.path(), bytes}});
+    };
+
+    // Top level: motion exports and pre-roll clips (tmp/ is the live ring)
+    std::error_code dec;
+    for (const auto &e : fs::directory_iterator(camDir.path(), dec))
+      collect(e);
+
+    fs::path continuous = camDir.path() / "continuous";
+    if (fs::is_directory(continuous, dec)) {
+      for (const auto &e : fs::recursive_directory_iterator(continuous, dec))
+        collect(e);
+    }
+  }
+
+  size_t files = 0;
+  uint64_t bytes = 0;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (auto &f : found)
+      addLocked(f.first, std::move(f.second));
+    files = totalFiles_;
+    bytes = totalBytes_;
+  }
+
+  std::cout << "[Retention] Indexed " << files << " recordings ("
+            << bytes / (1024 * 1024) << " MB) under " << root_ << std::endl;
+}
+
+bool RetentionManager::overQuotaLocked() const {
+  if (global_.max_bytes && totalBytes_ > global_.max_bytes)
+    return true;
+  if (perCamera_.max_bytes) {
+    for (const auto &kv : cameras_)
+      if (kv.second.bytes > perCamera_.max_bytes)
+        return true;
+  }
+  return false;
+}
+
+void RetentionManager::evictOldestLocked(CameraIndex &cam,
+                                         std::vector<Recording> &victims) {
+  auto it = cam.files.begin();
+  cam.bytes -= it->bytes;
+  totalBytes_ -= it->bytes;
+  totalFiles_--;
+  known_.erase(it->path);
+  victims.push_back(*it);
+  cam.files.erase(it);
+}
+
+void RetentionManager::enforce() {
+  std::vector<Recording> victims;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    passes_++;
+
+    // Age: the stricter of the two limits
+    std::chrono::seconds maxAge{0};
+    for (auto age : {global_.max_age, perCamera_.max_age})
+      if (age.count() > 0 && (maxAge.count() == 0 || age < maxAge))
+        maxAge = age;
+    if (maxAge.count() > 0) {
+      auto cutoff = SysClock::now() - maxAge;
+      for (auto &kv : cameras_) {
+        CameraIndex &cam = kv.second;
+        while (!cam.files.empty() && cam.files.begin()->time < cutoff)
+          evictOldestLocked(cam, victims);
+      }
+    }
+
+    // Per-camera bytes
+    if (perCamera_.max_bytes) {
+      for (auto &kv : cameras_) {
+        CameraIndex &cam = kv.second;
+        while (!cam.files.empty() && cam.bytes > perCamera_.max_bytes)
+          evictOldestLocked(cam, victims);
+      }
+    }
+
+    // Global bytes: oldest recording across all cameras goes first
+    while (global_.max_bytes && totalBytes_ > global_.max_bytes) {
+      CameraIndex *oldest = nullptr;
+      for (auto &kv : cameras_) {
+        CameraIndex &cam = kv.second;
+        if (!cam.files.empty() &&
+            (!oldest || cam.files.begin()->time < oldest->files.begin()->time))
+          oldest = &cam;
+      }
+      if (!oldest)
+        break;
+      evictOldestLocked(*oldest, victims);
+    }
+
+    for (const auto &v : victims)
+      evictedBytes_ += v.bytes;
+    evictedFiles_ += victims.size();
+  }
+
+  // Unlocked: writers reporting new files never wait on the disk here
+  uint64_t bytes = 0;
+  for (const auto &v : victims) {
+    removeFile(v.path);
+    bytes += v.bytes;
+  }
+  if (!victims.empty())
+    std::cout << "[Retention] Evicted " << victims.size() << " recordings ("
+              << bytes / (1024 * 1024) << " MB)" << std::endl;
+}
+
+void RetentionManager::removeFile(const fs::path &path) {
+  std::error_code ec;
+  fs::remove(path, ec);
+  if (ec) {
+    std::cerr << "[Retention] Failed to delete " << path << ": "
+              << ec.message() << std::endl;
+    return;
+  }
+
+  // continuous/YYYY-MM-DD/HH: drop the hour (and its index) with its last
+  // file, then the day once it's empty
+  fs::path hour = path.parent_path();
+  fs::path day = hour.parent_path();
+  if (day.parent_path().filename() != "continuous")
+    return;
+
+  bool hourEmpty = true;
+  for (const auto &e : fs::directory_iterator(hour, ec)) {
+    if (e.path().extension() == ".ts") {
+      hourEmpty = false;
+      break;
+    }
+  }
+  if (ec || !hourEmpty)
+    return;
+  fs::remove_all(hour, ec);
+  if (fs::is_empty(day, ec))
+    fs::remove(day, ec);
+}
+
+RetentionUsage RetentionManager::usage() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  RetentionUsage u;
+  u.bytes = totalBytes_;
+  u.files = totalFiles_;
+  u.evicted_files = evictedFiles_;
+  u.evicted_bytes = evictedBytes_;
+  u.passes = passes_;
+  for (const auto &kv : cameras_) {
+    const CameraIndex &cam = kv.second;
+    RetentionCameraUsage c;
+    c.camera = kv.first;
+    c.bytes = cam.bytes;
+    c.files = cam.files.size();
+    if (!cam.files.empty()) {
+      c.oldest = cam.files.begin()->time;
+      c.newest = cam.files.rbegin()->time;
+    }
+    u.cameras.push_back(std::move(c));
+  }
+  return u;
+}
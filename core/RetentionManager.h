@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Byte and age limits; 0 disables a limit
+struct RetentionPolicy {
+  uint64_t max_bytes = 0;
+  std::chrono::seconds max_age{0};
+};
+
+struct RetentionCameraUsage {
+  std::string camera; // Directory name under the media root
+  uint64_t bytes = 0;
+  size_t files = 0;
+  std::chrono::system_clock::time_point oldest;
+  std::chrono::system_clock::time_point newest;
+};
+
+struct RetentionUsage {
+  uint64_t bytes = 0;
+  size_t files = 0;
+  uint64_t evicted_files = 0;
+  uint64_t evicted_bytes = 0;
+  uint64_t passes = 0;
+  std::vector<RetentionCameraUsage> cameras;
+};
+
+// Keeps finished recordings under the media root within quota by deleting
+// the oldest first.
+//
+// Recordings are what the cameras finish writing under media/<camera>/:
+// motion exports and pre-roll clips at the top level, and continuous
+// recording files below continuous/. The in-memory index is built by one
+// walk of the media root when the service starts; after that, writers
+// report each finished file through add() and eviction passes only look at
+// the index, never at the directories.
+class RetentionManager {
+public:
+  RetentionManager(const std::filesystem::path &mediaRoot,
+                   RetentionPolicy global, RetentionPolicy perCamera,
+                   std::chrono::seconds interval);
+  ~RetentionManager();
+
+  void start();
+  void stop();
+
+  // A finished recording under the media root; safe from any thread
+  void add(const std::filesystem::path &file);
+
+  RetentionUsage usage() const;
+  RetentionPolicy globalPolicy() const { return global_; }
+  RetentionPolicy cameraPolicy() const { return perCamera_; }
+  bool running() const;
+
+private:
+  struct Recording {
+    std::chrono::system_clock::time_point time;
+    std::filesystem::path path;
+    uint64_t bytes = 0;
+
+    bool operator<(const Recording &o) const {
+      return time != o.time ? time < o.time : path < o.path;
+    }
+  };
+
+  struct CameraIndex {
+    std::set<Recording> files; // Oldest first
+    uint64_t bytes = 0;
+  };
+
+  void run();
+  void scanAll();
+  void enforce();
+  bool overQuotaLocked() const;
+  void addLocked(const std::string &camera, Recording rec);
+  void evictOldestLocked(CameraIndex &cam, std::vector<Recording> &victims);
+  void removeFile(const std::filesystem::path &path);
+  std::string cameraOf(const std::filesystem::path &file) const;
+
+  std::filesystem::path root_;
+  RetentionPolicy global_;
+  RetentionPolicy perCamera_;
+  std::chrono::seconds interval_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+  bool running_ = false;
+  bool wake_ = false;
+
+  std::map<std::string, CameraIndex> cameras_;
+  // Every indexed path, with the time it is indexed under
+  std::map<std::filesystem::path, std::chrono::system_clock::time_point>
+      known_;
+  uint64_t totalBytes_ = 0;
+  size_t totalFiles_ = 0;
+  uint64_t evictedFiles_ = 0;
+  uint64_t evictedBytes_ = 0;
+  uint64_t passes_ = 0;
+};
@@ -0,0 +1,162 @@
+#include "SegmentGate.h"
+#include <iostream>
+
+SegmentGate::SegmentGate(const std::string &name) : name_(name) {
+  video_.owner = this;
+  video_.video = true;
+  audio_.owner = this;
+  audio_.video = false;
+}
+
+SegmentGate::~SegmentGate() { detach(); }
+
+bool SegmentGate::attach(GstElement *videoQueue, GstElement *audioQueue) {
+  detach();
+
+  std::lock_guard<std::mutex> lk(mutex_);
+  open_ = false;
+  primed_ = false;
+  videoStart_ = GST_CLOCK_TIME_NONE;
+
+  if (!videoQueue || !attachBranch(video_, videoQueue, true)) {
+    std::cerr << "[SegmentGate] " << name_ << ": no video queue to gate"
+              << std::endl;
+    return false;
+  }
+  if (audioQueue && !attachBranch(audio_, audioQueue, false))
+    std::cerr << "[SegmentGate] " << name_ << ": audio left ungated"
+              << std::endl;
+
+  blockLocked(video_);
+  blockLocked(audio_);
+  return true;
+}
+
+bool SegmentGate::attachBranch(Branch &b, GstElement *queue, bool video) {
+  b.video = video;
+  b.pad = gst_element_get_static_pad(queue, "src");
+  b.peer = b.pad ? gst_pad_get_peer(b.pad) : nullptr;
+  if (!b.peer) {
+    detachBranch(b);
+    return false;
+  }
+  b.heldPts = GST_CLOCK_TIME_NONE;
+  b.trimming = false;
+  b.filterId = gst_pad_add_probe(b.peer, GST_PAD_PROBE_TYPE_BUFFER,
+                                 &SegmentGate::onReleased, &b, nullptr);
+  return true;
+}
+
+void SegmentGate::detach() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  detachBranch(video_);
+  detachBranch(audio_);
+  open_ = false;
+}
+
+void SegmentGate::detachBranch(Branch &b) {
+  unblockLocked(b);
+  if (b.filterId && b.peer)
+    gst_pad_remove_probe(b.peer, b.filterId);
+  b.filterId = 0;
+  if (b.peer)
+    gst_object_unref(b.peer);
+  if (b.pad)
+    gst_object_unref(b.pad);
+  b.peer = nullptr;
+  b.pad = nullptr;
+}
+
+void SegmentGate::blockLocked(Branch &b) {
+  if (!b.pad || b.blockId)
+    return;
+  b.heldPts = GST_CLOCK_TIME_NONE;
+  // Buffers only: caps/segment events still reach splitmuxsink
+  b.blockId = gst_pad_add_probe(
+      b.pad,
+      static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BLOCK |
+                                   GST_PAD_PROBE_TYPE_BUFFER),
+      &SegmentGate::onBlocked, &b, nullptr);
+}
+
+void SegmentGate::unblockLocked(Branch &b) {
+  if (!b.pad || !b.blockId)
+    return;
+  gst_pad_remove_probe(b.pad, b.blockId);
+  b.blockId = 0;
+}
+
+void SegmentGate::open() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (open_ || !video_.pad)
+    return;
+
+  videoStart_ = GST_CLOCK_TIME_NONE;
+  // Trim first, then let the pre-roll go
+  video_.trimming = true;
+  audio_.trimming = audio_.pad != nullptr;
+  unblockLocked(video_);
+  unblockLocked(audio_);
+
+  open_ = true;
+  primed_ = true;
+  std::cout << "[SegmentGate] " << name_ << ": opened" << std::endl;
+}
+
+void SegmentGate::close() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (!open_)
+    return;
+
+  blockLocked(video_);
+  blockLocked(audio_);
+
+  open_ = false;
+  std::cout << "[SegmentGate] " << name_ << ": closed" << std::endl;
+}
+
+GstPadProbeReturn SegmentGate::onBlocked(GstPad * /*pad*/,
+                                         GstPadProbeInfo *info,
+                                         gpointer user_data) {
+  auto *b = static_cast<Branch *>(user_data);
+  if (GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info))
+    b->heldPts = GST_BUFFER_PTS(buf);
+  return GST_PAD_PROBE_OK; // Stay blocked until open()
+}
+
+GstPadProbeReturn SegmentGate::onReleased(GstPad * /*pad*/,
+                                          GstPadProbeInfo *info,
+                                          gpointer user_data) {
+  auto *b = static_cast<Branch *>(user_data);
+  if (!b->trimming)
+    return GST_PAD_PROBE_OK;
+
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (!buf)
+    return GST_PAD_PROBE_OK;
+  GstClockTime pts = GST_BUFFER_PTS(buf);
+
+  GstClockTime held = b->heldPts;
+  if (GST_CLOCK_TIME_IS_VALID(held) && GST_CLOCK_TIME_IS_VALID(pts) &&
+      pts <= held)
+    return GST_PAD_PROBE_DROP;
+
+  if (b->video) {
+    // The leaky queue drops from the front, so the pre-roll usually starts
+    // mid-GOP; skip to its first keyframe
+    if (GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT))
+      return GST_PAD_PROBE_DROP;
+    b->owner->videoStart_ = pts;
+    b->trimming = false;
+    return GST_PAD_PROBE_OK;
+  }
+
+  // Audio waits for the video keyframe so both start together; samples
+  // released before the video thread finds it are lost
+  GstClockTime start = b->owner->videoStart_;
+  if (!GST_CLOCK_TIME_IS_VALID(start) ||
+      (GST_CLOCK_TIME_IS_VALID(pts) && pts < start))
+    return GST_PAD_PROBE_DROP;
+  b->trimming = false;
+  return GST_PAD_PROBE_OK;
+}
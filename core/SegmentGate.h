@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <gst/gst.h>
+#include <mutex>
+#include <string>
+
+// Holds the segment branch of a camera pipeline shut while there is no
+// motion, so splitmuxsink writes nothing to disk during idle periods.
+//
+// The branch starts with a leaky queue sized to the pre-roll window. While
+// the gate is closed a blocking probe parks the queue's source pad; the
+// queue keeps filling and drops its oldest buffers, so it always holds the
+// last few seconds of encoded video in memory. Opening the gate removes the
+// block and the queued pre-roll flows into splitmuxsink, starting from the
+// first keyframe in it. Audio, when present, is gated the same way and
+// trimmed to start with that keyframe.
+class SegmentGate {
+public:
+  explicit SegmentGate(const std::string &name);
+  ~SegmentGate();
+
+  // Takes the leaky queues feeding splitmuxsink (audioQueue may be null) and
+  // closes the gate. Call before the pipeline goes to PLAYING.
+  bool attach(GstElement *videoQueue, GstElement *audioQueue);
+  void detach();
+
+  void open();
+  void close();
+  bool isOpen() const { return open_.load(); }
+  // True once footage has been let through since attach(), i.e.
+  // splitmuxsink has a fragment open
+  bool primed() const { return primed_.load(); }
+
+private:
+  struct Branch {
+    SegmentGate *owner = nullptr;
+    bool video = true;
+    GstPad *pad = nullptr;  // Queue src pad, blocked while closed
+    GstPad *peer = nullptr; // Trims the released pre-roll
+    gulong blockId = 0;
+    gulong filterId = 0;
+    // Buffer parked in the blocked probe when the gate closed; it predates
+    // the pre-roll window
+    std::atomic<GstClockTime> heldPts{GST_CLOCK_TIME_NONE};
+    std::atomic<bool> trimming{false};
+  };
+
+  bool attachBranch(Branch &b, GstElement *queue, bool video);
+  void detachBranch(Branch &b);
+  void blockLocked(Branch &b);
+  void unblockLocked(Branch &b);
+
+  static GstPadProbeReturn onBlocked(GstPad *pad, GstPadProbeInfo *info,
+                                     gpointer user_data);
+  static GstPadProbeReturn onReleased(GstPad *pad, GstPadProbeInfo *info,
+                                      gpointer user_data);
+
+  std::string name_;
+  std::mutex mutex_; // Guards probe ids
+  Branch video_;
+  Branch audio_;
+  std::atomic<bool> open_{false};
+  std::atomic<bool> primed_{false};
+  // PTS of the keyframe the released video starts with
+  std::atomic<GstClockTime> videoStart_{GST_CLOCK_TIME_NONE};
+};
@@ -1,12 +1,15 @@
 #include "SegmentWorker.h"
 #include <chrono>
+#include <cstdio>
+#include <ctime>
 #include <filesystem>
 #include <iostream>
+#include <stdexcept>
 
 namespace fs = std::filesystem;
 
-SegmentWorker::SegmentWorker(const std::string &segmentPath, int msUpdate)
-    : segmentPath_(segmentPath), msUpdate_(msUpdate), running_(false),
+SegmentWorker::SegmentWorker(const std::string &segmentPath)
+    : segmentPath_(segmentPath), running_(false),
       state_(WorkerState::Stopped) {}
 
 void SegmentWorker::start() {
@@ -26,16 +29,28 @@ void SegmentWorker::start() {
               << std::endl;
   }
 
+  {
+    std::lock_guard<std::mutex> lock(eventMutex_);
+    events_.clear();
+  }
+  openedAt_.clear();
+  lastOpened_.clear();
+  discard_.clear();
+
   running_ = true;
   state_ = WorkerState::Working;
 
-  workerThread_ = std::thread([this]() { scanSegmentDir(); });
+  workerThread_ = std::thread([this]() { eventLoop(); });
 
   std::cout << "[SegmentWorker] Started." << std::endl;
 }
 
 void SegmentWorker::stop() {
-  running_ = false;
+  {
+    std::lock_guard<std::mutex> lock(eventMutex_);
+    running_ = false;
+  }
+  eventCv_.notify_all();
   if (workerThread_.joinable()) {
     workerThread_.join();
   }
@@ -67,100 +82,158 @@ std::vector<std::filesystem::path> SegmentWorker::getAndResetMotionSegments() {
   return result;
 }
 
-void SegmentWorker::scanSegmentDir() {
-  while (running_) {
-    try {
-      // Scan segment directory
-      fs::file_time_type newestTime;
-      std::string newestFile;
-      for (const auto &entry : fs::directory_iterator(segmentPath_)) {
-        if (!entry.is_regular_file())
-          continue;
-
-        std::string filename = entry.path().filename().string();
-        if (filename.find(".mkv") == std::string::npos)
-          continue;
-
-        auto lastWrite = fs::last_write_time(entry);
-        if (newestFile.empty() || lastWrite > newestTime) {
-          newestTime = lastWrite;
-          newestFile = filename;
-        }
-      }
-      currentSegment_ = newestFile;
-      if (currentSegment_ != savedSegment_) {
-        // std::cout << "[SegmentWorker] Segment switch to " << currentSegment_
-        //           << std::endl;
-
-        bool shouldSave = false;
-        {
-          std::lock_guard<std::mutex> lock(saveMutex_);
-          if (saveCurrentSegment_) {
-            shouldSave = true;
-          }
-        }
-
-        // Only save if we have a valid previous segment filename
-        if (shouldSave && !savedSegment_.empty()) {
-          bool success = false;
-          fs::path outputFilename;
-          try {
-            fs::path src = fs::path(segmentPath_) / savedSegment_;
-
-            // Verify source file exists and is a regular file
-            if (!fs::exists(src)) {
-              std::cerr << "[SegmentWorker] Source file does not exist: "
-                        << src << std::endl;
-              throw std::runtime_error("Source file not found");
-            }
-            if (!fs::is_regular_file(src)) {
-              std::cerr << "[SegmentWorker] Source is not a regular file: "
-                        << src << std::endl;
-              throw std::runtime_error("Source is not a file");
-            }
-
-            // Get current time
-            auto now = std::chrono::system_clock::now();
-            std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-
-            // Format time as YYYY-MM-DD_HH-MM-SS
-            std::tm tm;
-            localtime_r(&now_c, &tm); // or localtime_s on Windows
-            char buffer[64];
-            std::strftime(buffer, sizeof(buffer), "%Y-%m-%d_%H-%M-%S", &tm);
-
-            // Build new filename
-            fs::path dstFilename = std::string(buffer) + ".mkv";
-            outputFilename = dstFilename;
-            fs::path dst = fs::path(savedPath_) / dstFilename;
-
-            fs::copy_file(src, dst, fs::copy_options::overwrite_existing);
-            std::cout << "[SegmentWorker] Saved segment to " << dst
-                      << std::endl;
-            success = true;
-          } catch (const std::exception &ex) {
-            std::cerr << "[SegmentWorker] Failed to copy segment: " << ex.what()
-                      << std::endl;
-          }
-
-          if (success) {
-            std::lock_guard<std::mutex> lock(saveMutex_);
-            motionSegments_.push_back(fs::path(savedPath_) / outputFilename);
-            saveCurrentSegment_ = false;
-            if (getState() == WorkerState::FinishRequested) {
-              std::cerr << "[SegmentWorker] Reporting finished" << std::endl;
-              setState(WorkerState::Finalized);
-            }
-          }
-        }
-        savedSegment_ = currentSegment_;
-      }
-
-    } catch (const std::exception &ex) {
-      std::cerr << "[SegmentWorker] Error scanning dir: " << ex.what()
-                << std::endl;
+void SegmentWorker::onFragmentOpened(const std::string &location,
+                                     uint64_t runningTimeNs) {
+  pushEvent(FragmentEvent::Kind::Opened, location, runningTimeNs);
+}
+
+void SegmentWorker::onFragmentClosed(const std::string &location,
+                                     uint64_t runningTimeNs) {
+  pushEvent(FragmentEvent::Kind::Closed, location, runningTimeNs);
+}
+
+void SegmentWorker::discardOpenFragment() {
+  // Queued like a fragment event so it applies to whatever was opened
+  // before this call, not to a fragment opened later
+  pushEvent(FragmentEvent::Kind::Discard, {}, 0);
+}
+
+void SegmentWorker::pushEvent(FragmentEvent::Kind kind,
+                              const std::string &location,
+                              uint64_t runningTimeNs) {
+  FragmentEvent ev;
+  ev.kind = kind;
+  ev.location = location;
+  ev.runningTimeNs = runningTimeNs;
+  ev.wallTime = std::chrono::system_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(eventMutex_);
+    events_.push_back(std::move(ev));
+  }
+  eventCv_.notify_one();
+}
+
+void SegmentWorker::eventLoop() {
+  while (true) {
+    std::deque<FragmentEvent> batch;
+    {
+      std::unique_lock<std::mutex> lock(eventMutex_);
+      eventCv_.wait(lock, [this] { return !events_.empty() || !running_; });
+      if (events_.empty() && !running_)
+        break;
+      batch.swap(events_);
     }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(msUpdate_));
+    for (const auto &ev : batch)
+      handleEvent(ev);
+  }
+}
+
+void SegmentWorker::handleEvent(const FragmentEvent &ev) {
+  if (ev.kind == FragmentEvent::Kind::Opened) {
+    // With async-finalize the previous fragment may still be closing, so the
+    // open time is kept per fragment rather than only for the current one
+    openedAt_[ev.location] = ev.wallTime;
+    lastOpened_ = ev.location;
+    return;
+  }
+
+  if (ev.kind == FragmentEvent::Kind::Discard) {
+    if (openedAt_.count(lastOpened_))
+      discard_.insert(lastOpened_);
+    return;
+  }
+
+  auto it = openedAt_.find(ev.location);
+  auto openedAt = it != openedAt_.end() ? it->second : ev.wallTime;
+  if (it != openedAt_.end())
+    openedAt_.erase(it);
+
+  if (discard_.erase(ev.location)) {
+    std::cout << "[SegmentWorker] Discarded stale fragment " << ev.location
+              << std::endl;
+    return;
   }
+
+  bool shouldSave = false;
+  {
+    std::lock_guard<std::mutex> lock(saveMutex_);
+    shouldSave = saveCurrentSegment_;
+  }
+  if (!shouldSave)
+    return;
+
+  // The fragment is finalized at this point, nothing is still writing to it
+  fs::path outputFilename;
+  try {
+    outputFilename = retainSegment(ev.location, openedAt);
+  } catch (const std::exception &ex) {
+    std::cerr << "[SegmentWorker] Failed to retain segment: " << ex.what()
+              << std::endl;
+    return;
+  }
+
+  std::cout << "[SegmentWorker] Retained segment as " << outputFilename
+            << " (closed at running time " << ev.runningTimeNs / 1000000000ULL
+            << "s)" << std::endl;
+
+  std::lock_guard<std::mutex> lock(saveMutex_);
+  motionSegments_.push_back(outputFilename);
+  saveCurrentSegment_ = false;
+  if (getState() == WorkerState::FinishRequested) {
+    std::cerr << "[SegmentWorker] Reporting finished" << std::endl;
+    setState(WorkerState::Finalized);
+  }
+}
+
+fs::path SegmentWorker::retainSegment(const fs::path &src,
+                                      std::chrono::system_clock::time_point
+                                          openedAt) {
+  if (!fs::is_regular_file(src)) {
+    std::cerr << "[SegmentWorker] Source is not a regular file: " << src
+              << std::endl;
+    throw std::runtime_error("Source file not found");
+  }
+
+  // Name it after the moment the fragment was opened, in UTC with
+  // milliseconds (YYYY-MM-DD_HH-MM-SS-mmmZ): the wall-clock start of its
+  // footage, unambiguous across DST changes
+  std::time_t opened_c = std::chrono::system_clock::to_time_t(openedAt);
+  const int ms = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+                         openedAt.time_since_epoch())
+                         .count() %
+                     1000);
+  std::tm tm;
+  gmtime_r(&opened_c, &tm); // or gmtime_s on Windows
+  char buffer[64];
+  std::strftime(buffer, sizeof(buffer), "%Y-%m-%d_%H-%M-%S", &tm);
+  char stamp[80];
+  std::snprintf(stamp, sizeof(stamp), "%s-%03dZ", buffer, ms);
+
+  // Fragments opened in the same millisecond (split-now) get a counter;
+  // rename would otherwise silently replace a saved recording
+  fs::path dst = fs::path(savedPath_) / (std::string(stamp) + ".mkv");
+  for (int n = 1; fs::exists(dst); ++n)
+    dst = fs::path(savedPath_) /
+          (std::string(stamp) + "_" + std::to_string(n) + ".mkv");
+
+  // Move the finalized fragment out of the splitmux ring instead of copying
+  // it. saved/ lives inside the tmp dir, so this is a metadata-only rename,
+  // and the ring slot name is freed: when splitmuxsink wraps around
+  // (max-files) it creates a new file rather than truncating ours. A hard
+  // link would not survive that truncation, so rename is the only zero-copy
+  // option here.
+  std::error_code ec;
+  fs::rename(src, dst, ec);
+  if (!ec)
+    return dst;
+
+  if (ec != std::errc::cross_device_link)
+    throw fs::filesystem_error("rename", src, dst, ec);
+
+  // saved/ on another filesystem: copy (libstdc++ uses copy_file_range or
+  // sendfile, so the data still stays in the kernel), then drop the source
+  fs::copy_file(src, dst); // Throws rather than overwrite
+  fs::remove(src, ec);
+  return dst;
 }
@@ -1,17 +1,27 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <map>
 #include <mutex>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
 
+// Tracks splitmuxsink fragments and moves the ones that contain motion to
+// the "saved" directory. Fragment boundaries come from the pipeline's
+// splitmuxsink-fragment-opened/-closed messages (see CameraStream's bus
+// handler), so the tmp directory is never scanned.
 class SegmentWorker {
 public:
   enum class WorkerState { Stopped, Working, FinishRequested, Finalized };
 
-  SegmentWorker(const std::string &segmentPath, int msUpdate = 500);
+  explicit SegmentWorker(const std::string &segmentPath);
 
   void start();
   void stop();
@@ -20,16 +30,35 @@ public:
   WorkerState getState() const;
   std::vector<std::filesystem::path> getAndResetMotionSegments();
 
+  // Called from GStreamer streaming threads; only queue the event
+  void onFragmentOpened(const std::string &location, uint64_t runningTimeNs);
+  void onFragmentClosed(const std::string &location, uint64_t runningTimeNs);
+  // The fragment splitmuxsink currently has open is not kept, even if motion
+  // is flagged when it closes. Used when a gated segment branch reopens: the
+  // open fragment then holds the tail of the previous motion event.
+  void discardOpenFragment();
+
 private:
-  void scanSegmentDir(); // Called by thread in start()
+  struct FragmentEvent {
+    enum class Kind { Opened, Closed, Discard } kind = Kind::Opened;
+    std::string location;
+    uint64_t runningTimeNs = 0;
+    std::chrono::system_clock::time_point wallTime;
+  };
+
+  void pushEvent(FragmentEvent::Kind kind, const std::string &location,
+                 uint64_t runningTimeNs);
+  void eventLoop(); // Called by thread in start()
+  void handleEvent(const FragmentEvent &ev);
+  std::filesystem::path
+  retainSegment(const std::filesystem::path &src,
+                std::chrono::system_clock::time_point openedAt);
 
   std::string segmentPath_;
   std::string savedPath_; // Saved segments
 
   std::vector<std::filesystem::path> motionSegments_;
 
-  int msUpdate_;
-
   std::thread workerThread_;
   std::atomic<bool> running_;
   bool saveCurrentSegment_ = false;
@@ -37,6 +66,12 @@ private:
 
   std::atomic<WorkerState> state_;
 
-  std::string currentSegment_;
-  std::string savedSegment_;
+  std::mutex eventMutex_;
+  std::condition_variable eventCv_;
+  std::deque<FragmentEvent> events_;
+
+  // Wall-clock open time per fragment still being written; worker thread only
+  std::map<std::string, std::chrono::system_clock::time_point> openedAt_;
+  std::string lastOpened_;        // Worker thread only
+  std::set<std::string> discard_; // Worker thread only
 };
@@ -64,6 +64,18 @@ float Settings::motion_frame_scale() const {
   return defaults_.motion_frame_scale_;
 }
 
+int Settings::motion_fps() const {
+  if (json_.contains("motion_fps"))
+    return json_["motion_fps"];
+  return defaults_.motion_fps_;
+}
+
+std::string Settings::motion_decode_mode() const {
+  if (json_.contains("motion_decode_mode"))
+    return json_["motion_decode_mode"];
+  return defaults_.motion_decode_mode_;
+}
+
 // -------- MOTION ANALYSIS PARAMS ---------
 float Settings::noise_threshold() const {
   if (json_.contains("noise_threshold"))
@@ -96,6 +108,179 @@ int Settings::motion_arrow_thickness() const {
   return defaults_.motion_arrow_thickness_;
 }
 
+// -------- FEATURE TRACKING ---------
+int Settings::feature_redetect_interval() const {
+  if (json_.contains("feature_redetect_interval"))
+    return json_["feature_redetect_interval"];
+  return defaults_.feature_redetect_interval_;
+}
+float Settings::feature_min_survivor_ratio() const {
+  if (json_.contains("feature_min_survivor_ratio"))
+    return json_["feature_min_survivor_ratio"];
+  return defaults_.feature_min_survivor_ratio_;
+}
+
+// -------- FRAME-DIFF PRE-GATE ---------
+float Settings::diff_gate_ratio() const {
+  if (json_.contains("diff_gate_ratio"))
+    return json_["diff_gate_ratio"];
+  return defaults_.diff_gate_ratio_;
+}
+int Settings::diff_gate_pixel_threshold() const {
+  if (json_.contains("diff_gate_pixel_threshold"))
+    return json_["diff_gate_pixel_threshold"];
+  return defaults_.diff_gate_pixel_threshold_;
+}
+
+// -------- MOTION OVERLAY ---------
+int Settings::motion_view_timeout_seconds() const {
+  if (json_.contains("motion_view_timeout_seconds"))
+    return json_["motion_view_timeout_seconds"];
+  return defaults_.motion_view_timeout_seconds_;
+}
+
+int Settings::motion_stream_max_clients() const {
+  if (json_.contains("motion_stream_max_clients"))
+    return json_["motion_stream_max_clients"];
+  return defaults_.motion_stream_max_clients_;
+}
+
+// -------- MOTION ENGINE ---------
+std::string Settings::motion_engine() const {
+  if (json_.contains("motion_engine"))
+    return json_["motion_engine"];
+  return defaults_.motion_engine_;
+}
+int Settings::frame_diff_pixel_threshold() const {
+  if (json_.contains("frame_diff_pixel_threshold"))
+    return json_["frame_diff_pixel_threshold"];
+  return defaults_.frame_diff_pixel_threshold_;
+}
+int Settings::bg_subtractor_history() const {
+  if (json_.contains("bg_subtractor_history"))
+    return json_["bg_subtractor_history"];
+  return defaults_.bg_subtractor_history_;
+}
+float Settings::bg_subtractor_var_threshold() const {
+  if (json_.contains("bg_subtractor_var_threshold"))
+    return json_["bg_subtractor_var_threshold"];
+  return defaults_.bg_subtractor_var_threshold_;
+}
+float Settings::mv_fallback_band() const {
+  if (json_.contains("mv_fallback_band"))
+    return json_["mv_fallback_band"];
+  return defaults_.mv_fallback_band_;
+}
+float Settings::mv_fallback_intra_ratio() const {
+  if (json_.contains("mv_fallback_intra_ratio"))
+    return json_["mv_fallback_intra_ratio"];
+  return defaults_.mv_fallback_intra_ratio_;
+}
+
+// -------- MOTION WORKER POOL ---------
+int Settings::motion_worker_threads() const {
+  if (json_.contains("motion_worker_threads"))
+    return json_["motion_worker_threads"];
+  return defaults_.motion_worker_threads_;
+}
+
+// -------- EXPORT POOL ---------
+int Settings::export_workers() const {
+  if (json_.contains("export_workers"))
+    return json_["export_workers"];
+  return defaults_.export_workers_;
+}
+
+int Settings::export_queue_limit() const {
+  if (json_.contains("export_queue_limit"))
+    return json_["export_queue_limit"];
+  return defaults_.export_queue_limit_;
+}
+
+// -------- PRE-ROLL ---------
+int Settings::preroll_seconds() const {
+  if (json_.contains("preroll_seconds"))
+    return json_["preroll_seconds"];
+  return defaults_.preroll_seconds_;
+}
+
+int Settings::preroll_max_mb() const {
+  if (json_.contains("preroll_max_mb"))
+    return json_["preroll_max_mb"];
+  return defaults_.preroll_max_mb_;
+}
+
+// -------- CONTINUOUS RECORDING ---------
+int Settings::record_segment_seconds() const {
+  if (json_.contains("record_segment_seconds"))
+    return json_["record_segment_seconds"];
+  return defaults_.record_segment_seconds_;
+}
+
+// -------- RETENTION ---------
+double Settings::retention_max_gb() const {
+  if (json_.contains("retention_max_gb"))
+    return json_["retention_max_gb"];
+  return defaults_.retention_max_gb_;
+}
+
+int Settings::retention_max_days() const {
+  if (json_.contains("retention_max_days"))
+    return json_["retention_max_days"];
+  return defaults_.retention_max_days_;
+}
+
+double Settings::retention_camera_max_gb() const {
+  if (json_.contains("retention_camera_max_gb"))
+    return json_["retention_camera_max_gb"];
+  return defaults_.retention_camera_max_gb_;
+}
+
+int Settings::retention_camera_max_days() const {
+  if (json_.contains("retention_camera_max_days"))
+    return json_["retention_camera_max_days"];
+  return defaults_.retention_camera_max_days_;
+}
+
+int Settings::retention_interval_seconds() const {
+  if (json_.contains("retention_interval_seconds"))
+    return json_["retention_interval_seconds"];
+  return defaults_.retention_interval_seconds_;
+}
+
+// -------- CAMERA STARTUP ---------
+int Settings::camera_startup_threads() const {
+  if (json_.contains("camera_startup_threads"))
+    return json_["camera_startup_threads"];
+  return defaults_.camera_startup_threads_;
+}
+
+// -------- STREAM PROBE CACHE ---------
+int Settings::stream_probe_ttl_seconds() const {
+  if (json_.contains("stream_probe_ttl_seconds"))
+    return json_["stream_probe_ttl_seconds"];
+  return defaults_.stream_probe_ttl_seconds_;
+}
+
+// -------- PIPELINE SUPERVISOR ---------
+int Settings::stream_stall_seconds() const {
+  if (json_.contains("stream_stall_seconds"))
+    return json_["stream_stall_seconds"];
+  return defaults_.stream_stall_seconds_;
+}
+
+int Settings::reconnect_backoff_min_seconds() const {
+  if (json_.contains("reconnect_backoff_min_seconds"))
+    return json_["reconnect_backoff_min_seconds"];
+  return defaults_.reconnect_backoff_min_seconds_;
+}
+
+int Settings::reconnect_backoff_max_seconds() const {
+  if (json_.contains("reconnect_backoff_max_seconds"))
+    return json_["reconnect_backoff_max_seconds"];
+  return defaults_.reconnect_backoff_max_seconds_;
+}
+
 // -------- VIDEO OUTPUT FORMAT ---------
 std::string Settings::video_output_format() const {
   if (json_.contains("video_output_format"))
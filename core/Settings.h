@@ -20,6 +20,8 @@ public:
   // Motion frame sizing/scaling
   IntSize motionFrameSize() const;
   float motion_frame_scale() const;
+  int motion_fps() const;
+  std::string motion_decode_mode() const;
 
   // Motion analysis parameters
   float noise_threshold() const;
@@ -29,6 +31,64 @@ public:
   float motion_arrow_scale() const;
   int motion_arrow_thickness() const;
 
+  // Sparse feature tracking (re-detect every N frames or when too few survive)
+  int feature_redetect_interval() const;
+  float feature_min_survivor_ratio() const;
+
+  // Frame-difference pre-gate ahead of optical flow
+  float diff_gate_ratio() const;
+  int diff_gate_pixel_threshold() const;
+
+  // Motion overlays are only drawn while someone fetched one this recently
+  int motion_view_timeout_seconds() const;
+  // Concurrent /motion_stream viewers; each one holds an HTTP worker thread
+  int motion_stream_max_clients() const;
+
+  // Motion detector engine (optical_flow, bg_subtract, frame_diff,
+  // motion_vectors) and the engines' tuning
+  std::string motion_engine() const;
+  int frame_diff_pixel_threshold() const;
+  int bg_subtractor_history() const;
+  float bg_subtractor_var_threshold() const;
+  // Motion vector engine: optical flow decides when the score is within
+  // band * motion_threshold of the threshold or this much is intra coded
+  float mv_fallback_band() const;
+  float mv_fallback_intra_ratio() const;
+
+  // Shared motion analysis pool size (0 = auto)
+  int motion_worker_threads() const;
+
+  // Motion clip export pool
+  int export_workers() const;
+  int export_queue_limit() const;
+
+  // In-memory pre-roll for motion clips (per camera)
+  int preroll_seconds() const;
+  int preroll_max_mb() const;
+
+  // Continuous recording: file length before rolling over at a keyframe
+  int record_segment_seconds() const;
+
+  // Recording retention: global and per-camera quotas (0 = unlimited),
+  // enforced oldest first every interval
+  double retention_max_gb() const;
+  int retention_max_days() const;
+  double retention_camera_max_gb() const;
+  int retention_camera_max_days() const;
+  int retention_interval_seconds() const;
+
+  // Cameras from cameras.json started in parallel at boot
+  int camera_startup_threads() const;
+
+  // How long an RTSP probe result is reused for the same URI (0 = never)
+  int stream_probe_ttl_seconds() const;
+
+  // Pipeline supervision: a camera without video for stream_stall_seconds
+  // (or with a bus error/EOS) is rebuilt, backing off exponentially
+  int stream_stall_seconds() const;
+  int reconnect_backoff_min_seconds() const;
+  int reconnect_backoff_max_seconds() const;
+
   // Video output
   std::string video_output_format() const;
 
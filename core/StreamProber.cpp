@@ -0,0 +1,240 @@
+#include "StreamProber.h"
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <gst/gst.h>
+#include <iostream>
+#include <set>
+
+namespace {
+
+struct Batch {
+  std::mutex m;
+  std::condition_variable cv;
+  size_t pending = 0;
+};
+
+// One rtspsrc of a batch; result fields are written under batch->m
+struct Slot {
+  Batch *batch = nullptr;
+  GstElement *pipeline = nullptr;
+  GstElement *src = nullptr;
+  gulong padHandler = 0;
+  gulong noMorePadsHandler = 0;
+  bool sawAudio = false;
+  bool sawVideo = false;
+  bool done = false;
+  StreamProbeResult result;
+};
+
+void finishLocked(Slot *slot, bool answered) {
+  if (slot->done)
+    return;
+  slot->done = true;
+  slot->result.audio.probed = answered;
+  slot->batch->pending--;
+  slot->batch->cv.notify_one();
+}
+
+// rtspsrc copies SDP attributes into the pad caps as "a-<name>" strings
+void parseVideoAttributes(const GstStructure *s, StreamProbeResult &r) {
+  if (const char *fr = gst_structure_get_string(s, "a-framerate"))
+    r.fps = std::atof(fr);
+  if (const char *fs = gst_structure_get_string(s, "a-framesize"))
+    std::sscanf(fs, "%*d %d-%d", &r.width, &r.height); // "96 1920-1080"
+  if (const char *dim = gst_structure_get_string(s, "a-x-dimensions"))
+    std::sscanf(dim, "%d,%d", &r.width, &r.height); // "1920,1080"
+}
+
+void onPadAdded(GstElement * /*src*/, GstPad *pad, gpointer user_data) {
+  auto *slot = static_cast<Slot *>(user_data);
+
+  // Prefer current caps; fall back to query
+  GstCaps *caps = gst_pad_get_current_caps(pad);
+  if (!caps)
+    caps = gst_pad_query_caps(pad, nullptr);
+  if (!caps)
+    return;
+
+  const GstStructure *s = gst_caps_get_structure(caps, 0);
+  const char *media = gst_structure_get_string(s, "media");
+  const char *enc = gst_structure_get_string(s, "encoding-name");
+
+  std::lock_guard<std::mutex> lk(slot->batch->m);
+  StreamProbeResult &r = slot->result;
+  if (media && g_str_equal(media, "audio") && !slot->sawAudio) {
+    slot->sawAudio = true;
+    r.audio.has_audio = true;
+    if (enc)
+      r.audio.encoding = enc;
+
+    int rate = 0, channels = 0;
+    gst_structure_get_int(s, "clock-rate", &rate); // RTP caps field
+    gst_structure_get_int(s, "channels", &channels);
+    if (!channels) {
+      if (const char *params = gst_structure_get_string(s, "encoding-params"))
+        channels = std::atoi(params);
+    }
+    if (rate)
+      r.audio.rate = rate;
+    if (channels)
+      r.audio.channels = channels;
+  } else if (media && g_str_equal(media, "video") && !slot->sawVideo) {
+    slot->sawVideo = true;
+    if (enc)
+      r.video_encoding = enc;
+    parseVideoAttributes(s, r);
+  }
+  gst_caps_unref(caps);
+
+  if (slot->sawAudio && slot->sawVideo)
+    finishLocked(slot, true);
+}
+
+void onNoMorePads(GstElement * /*src*/, gpointer user_data) {
+  auto *slot = static_cast<Slot *>(user_data);
+  std::lock_guard<std::mutex> lk(slot->batch->m);
+  finishLocked(slot, true);
+}
+
+} // namespace
+
+StreamProber::StreamProber(std::chrono::seconds ttl) : ttl_(ttl) {}
+
+StreamProbeResult StreamProber::probe(const std::string &uri,
+                                      int timeout_ms) {
+  return probe(std::vector<std::string>{uri}, timeout_ms).front();
+}
+
+std::vector<StreamProbeResult>
+StreamProber::probe(const std::vector<std::string> &uris, int timeout_ms) {
+  std::vector<StreamProbeResult> results(uris.size());
+  std::vector<std::string> misses;
+  std::set<std::string> missSet;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < uris.size(); ++i) {
+      auto it = cache_.find(uris[i]);
+      if (it != cache_.end() && it->second.expires > now) {
+        results[i] = it->second.result;
+        results[i].cached = true;
+      } else if (missSet.insert(uris[i]).second) {
+        misses.push_back(uris[i]);
+      }
+    }
+  }
+  if (misses.empty())
+    return results;
+
+  std::vector<StreamProbeResult> probed = probeUncached(misses, timeout_ms);
+
+  std::lock_guard<std::mutex> lk(mutex_);
+  const auto now = std::chrono::steady_clock::now();
+  for (auto it = cache_.begin(); it != cache_.end();) {
+    if (it->second.expires <= now)
+      it = cache_.erase(it);
+    else
+      ++it;
+  }
+  std::map<std::string, const StreamProbeResult *> byUri;
+  for (const auto &r : probed) {
+    byUri[r.uri] = &r;
+    if (r.audio.probed && ttl_.count() > 0)
+      cache_[r.uri] = Entry{r, now + ttl_};
+  }
+  for (size_t i = 0; i < uris.size(); ++i) {
+    auto it = byUri.find(uris[i]);
+    if (it != byUri.end())
+      results[i] = *it->second;
+  }
+  return results;
+}
+
+std::vector<StreamProbeResult>
+StreamProber::probeUncached(const std::vector<std::string> &uris,
+                            int timeout_ms) {
+  const auto t0 = std::chrono::steady_clock::now();
+  Batch batch;
+  std::vector<Slot> slots(uris.size());
+
+  // Start every DESCRIBE before waiting on any: each rtspsrc connects from
+  // its own task, so the batch takes as long as its slowest camera
+  for (size_t i = 0; i < uris.size(); ++i) {
+    Slot &slot = slots[i];
+    slot.batch = &batch;
+    slot.result.uri = uris[i];
+    slot.pipeline = gst_pipeline_new(nullptr);
+    slot.src = gst_element_factory_make("rtspsrc", nullptr);
+    if (!slot.pipeline || !slot.src) {
+      if (slot.src)
+        gst_object_unref(slot.src);
+      slot.src = nullptr;
+      slot.done = true;
+      continue;
+    }
+
+    // Force TCP so results match the camera pipelines
+    // NOTE: 4 == GST_RTSP_LOWER_TRANS_TCP (avoids extra headers/libs)
+    g_object_set(slot.src, "location", uris[i].c_str(), "protocols", 4,
+                 NULL);
+    gst_bin_add(GST_BIN(slot.pipeline), slot.src);
+
+    slot.padHandler = g_signal_connect(slot.src, "pad-added",
+                                       G_CALLBACK(onPadAdded), &slot);
+    slot.noMorePadsHandler = g_signal_connect(
+        slot.src, "no-more-pads", G_CALLBACK(onNoMorePads), &slot);
+
+    {
+      std::lock_guard<std::mutex> lk(batch.m);
+      batch.pending++;
+    }
+    // PAUSED is enough for rtspsrc to DESCRIBE and expose pads
+    if (gst_element_set_state(slot.pipeline, GST_STATE_PAUSED) ==
+        GST_STATE_CHANGE_FAILURE) {
+      std::lock_guard<std::mutex> lk(batch.m);
+      finishLocked(&slot, false);
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lk(batch.m);
+    batch.cv.wait_for(lk, std::chrono::milliseconds(timeout_ms),
+                      [&] { return batch.pending == 0; });
+  }
+
+  // NULL stops the rtspsrc tasks, so no callback touches a slot after this
+  size_t answered = 0;
+  std::vector<StreamProbeResult> results;
+  results.reserve(slots.size());
+  for (Slot &slot : slots) {
+    if (slot.pipeline) {
+      if (slot.src) {
+        g_signal_handler_disconnect(slot.src, slot.padHandler);
+        g_signal_handler_disconnect(slot.src, slot.noMorePadsHandler);
+      }
+      gst_element_set_state(slot.pipeline, GST_STATE_NULL);
+      gst_object_unref(slot.pipeline);
+    }
+    if (slot.result.audio.probed)
+      answered++;
+    results.push_back(std::move(slot.result));
+  }
+
+  const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - t0)
+                      .count();
+  std::cout << "[StreamProber] Probed " << uris.size() << " streams in " << ms
+            << " ms, " << answered << " answered" << std::endl;
+  return results;
+}
+
+void StreamProber::invalidate(const std::string &uri) {
+  std::lock_guard<std::mutex> lk(mutex_);
+  cache_.erase(uri);
+}
+
+size_t StreamProber::cacheSize() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return cache_.size();
+}
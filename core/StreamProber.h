@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct AudioProbeResult {
+  bool has_audio = false;
+  std::string encoding;
+  int channels = 0;
+  int rate = 0;
+  bool probed = false;
+};
+
+// What an RTSP DESCRIBE told us about a URI
+struct StreamProbeResult {
+  std::string uri;
+  AudioProbeResult audio;     // Feeds CameraStream::setAudioHint
+  std::string video_encoding; // RTP encoding name, e.g. H264
+  int width = 0;              // Only when the SDP carries it
+  int height = 0;
+  double fps = 0.0;
+  bool cached = false; // Answered from the cache
+};
+
+// Probes RTSP URIs with a throwaway rtspsrc each, many at once, and caches
+// the answers per URI so adding cameras doesn't wait on a fresh DESCRIBE
+// every time. Probes that time out are not cached.
+class StreamProber {
+public:
+  explicit StreamProber(std::chrono::seconds ttl);
+
+  // One result per URI, in order. Cache misses are probed concurrently; the
+  // call returns once all of them answered or timeout_ms passed.
+  std::vector<StreamProbeResult> probe(const std::vector<std::string> &uris,
+                                       int timeout_ms = 1500);
+  StreamProbeResult probe(const std::string &uri, int timeout_ms = 1500);
+
+  void invalidate(const std::string &uri);
+  size_t cacheSize() const;
+
+private:
+  struct Entry {
+    StreamProbeResult result;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  std::vector<StreamProbeResult>
+  probeUncached(const std::vector<std::string> &uris, int timeout_ms);
+
+  std::chrono::seconds ttl_;
+  mutable std::mutex mutex_;
+  std::map<std::string, Entry> cache_;
+};
@@ -0,0 +1,210 @@
+#include "StreamSupervisor.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+StreamSupervisor::StreamSupervisor(std::chrono::milliseconds stallTimeout,
+                                   std::chrono::milliseconds minBackoff,
+                                   std::chrono::milliseconds maxBackoff)
+    : stall_ms_(std::max<int64_t>(1000, stallTimeout.count())),
+      min_backoff_ms_(std::max<int64_t>(100, minBackoff.count())),
+      max_backoff_ms_(std::max<int64_t>(min_backoff_ms_, maxBackoff.count())) {
+}
+
+StreamSupervisor::~StreamSupervisor() { stop(); }
+
+void StreamSupervisor::start() {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (running_)
+    return;
+  running_ = true;
+  thread_ = std::thread(&StreamSupervisor::run, this);
+}
+
+void StreamSupervisor::stop() {
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    if (!running_)
+      return;
+    running_ = false;
+  }
+  cv_.notify_all();
+  if (thread_.joinable())
+    thread_.join();
+  std::cout << "[Supervisor] Stopped." << std::endl;
+}
+
+bool StreamSupervisor::running() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return running_;
+}
+
+SupervisedStreamHandle
+StreamSupervisor::addStream(const std::string &name,
+                            std::function<bool()> restart) {
+  auto s = std::make_shared<SupervisedStream>();
+  s->name = name;
+  s->restart = std::move(restart);
+  std::lock_guard<std::mutex> lk(mutex_);
+  s->armed_ms = nowMs();
+  streams_.push_back(s);
+  return s;
+}
+
+void StreamSupervisor::removeStream(const SupervisedStreamHandle &stream) {
+  if (!stream)
+    return;
+  std::unique_lock<std::mutex> lk(mutex_);
+  stream->removed = true;
+  idle_cv_.wait(lk, [&] { return !stream->restarting; });
+  streams_.erase(std::remove(streams_.begin(), streams_.end(), stream),
+                 streams_.end());
+}
+
+void StreamSupervisor::reportFailure(const SupervisedStreamHandle &stream,
+                                     const std::string &reason) {
+  if (!stream)
+    return;
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    // Errors from the pipeline being torn down for a restart don't count
+    if (stream->removed || stream->restarting)
+      return;
+    stream->failed = true;
+    stream->last_error = reason;
+    wake_ = true;
+  }
+  cv_.notify_one();
+}
+
+void StreamSupervisor::noteBuffer(SupervisedStream &stream) {
+  stream.last_buffer_ms.store(nowMs(), std::memory_order_relaxed);
+}
+
+void StreamSupervisor::checkLocked(SupervisedStream &s, int64_t now,
+                                   std::vector<SupervisedStreamHandle> &due,
+                                   const SupervisedStreamHandle &handle) {
+  if (s.removed || s.restarting)
+    return;
+
+  const int64_t lastBuffer = s.last_buffer_ms.load(std::memory_order_relaxed);
+  bool failed = s.failed;
+  s.failed = false;
+  std::string reason = s.last_error;
+
+  if (!failed && lastBuffer > s.armed_ms) {
+    if (s.down) {
+      s.down = false;
+      s.scheduled = false;
+      s.downtime_ms += now - s.down_since_ms;
+      std::cout << "[Supervisor] " << s.name << " recovered after "
+                << (now - s.down_since_ms) / 1000 << " s" << std::endl;
+    }
+  }
+
+  if (!failed && !s.scheduled &&
+      now - std::max(s.armed_ms, lastBuffer) > stall_ms_) {
+    failed = true;
+    reason = "no video for " + std::to_string(stall_ms_ / 1000) + " s";
+  }
+
+  if (failed && !s.scheduled) {
+    s.failures++;
+    s.last_error = reason;
+    if (!s.down) {
+      // New outage: rebuild right away, back off if it keeps failing
+      s.down = true;
+      s.down_since_ms = now;
+      s.backoff_ms = min_backoff_ms_;
+      s.next_attempt_ms = now;
+      std::cout << "[Supervisor] " << s.name << " down: " << reason
+                << std::endl;
+    } else {
+      s.next_attempt_ms = now + s.backoff_ms;
+      s.backoff_ms = std::min(s.backoff_ms * 2, max_backoff_ms_);
+    }
+    s.scheduled = true;
+  }
+
+  if (s.scheduled && now >= s.next_attempt_ms) {
+    s.scheduled = false;
+    s.restarting = true;
+    due.push_back(handle);
+  }
+}
+
+void StreamSupervisor::run() {
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (running_) {
+    cv_.wait_for(lk, std::chrono::seconds(1),
+                 [this] { return wake_ || !running_; });
+    wake_ = false;
+    if (!running_)
+      break;
+
+    const int64_t now = nowMs();
+    std::vector<SupervisedStreamHandle> due;
+    for (const auto &s : streams_)
+      checkLocked(*s, now, due, s);
+
+    // Unlocked: a rebuild can take seconds for a camera that doesn't answer
+    for (const auto &s : due) {
+      // Removed while queued, or shutting down: leave it alone
+      if (s->removed || !running_) {
+        s->restarting = false;
+        idle_cv_.notify_all();
+        continue;
+      }
+      std::cout << "[Supervisor] Reconnecting " << s->name << " (attempt "
+                << s->reconnects + 1 << ")" << std::endl;
+      lk.unlock();
+      bool started = s->restart();
+      lk.lock();
+
+      s->restarting = false;
+      s->reconnects++;
+      s->armed_ms = nowMs(); // Stall timer restarts with the new pipeline
+      if (!started) {
+        s->failed = true;
+        s->last_error = "pipeline failed to start";
+      }
+      idle_cv_.notify_all();
+    }
+  }
+}
+
+SupervisedStreamStats
+StreamSupervisor::stats(const SupervisedStreamHandle &stream) const {
+  SupervisedStreamStats st;
+  if (!stream)
+    return st;
+  std::lock_guard<std::mutex> lk(mutex_);
+  const int64_t now = nowMs();
+  st.down = stream->down;
+  st.failures = stream->failures;
+  st.reconnects = stream->reconnects;
+  st.last_error = stream->last_error;
+  int64_t downtime = stream->downtime_ms;
+  if (stream->down) {
+    downtime += now - stream->down_since_ms;
+    st.retry_in_seconds =
+        std::max<int64_t>(0, stream->next_attempt_ms - now) / 1000.0;
+  }
+  st.downtime_seconds = downtime / 1000.0;
+  return st;
+}
+
+size_t StreamSupervisor::downCount() const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  return std::count_if(streams_.begin(), streams_.end(),
+                       [](const SupervisedStreamHandle &s) { return s->down; });
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One supervised camera pipeline. The camera stamps last_buffer_ms from a
+// pad probe and reports bus errors through StreamSupervisor::reportFailure;
+// restart tears the pipeline down and builds it again, returning false if
+// the new one could not be started.
+struct SupervisedStream {
+  std::string name;
+  std::function<bool()> restart;
+  std::atomic<int64_t> last_buffer_ms{0}; // Steady clock, 0 = none yet
+
+  // Guarded by the supervisor mutex
+  bool removed = false;
+  bool restarting = false;
+  bool down = false;
+  bool failed = false;    // Reported since the last check
+  bool scheduled = false; // Restart due at next_attempt_ms
+  std::string last_error;
+  int64_t armed_ms = 0; // (Re)start time; stall timer runs from here
+  int64_t down_since_ms = 0;
+  int64_t next_attempt_ms = 0;
+  int64_t backoff_ms = 0; // Delay before the next restart while down
+  int64_t downtime_ms = 0;
+  uint64_t failures = 0;
+  uint64_t reconnects = 0;
+};
+
+using SupervisedStreamHandle = std::shared_ptr<SupervisedStream>;
+
+struct SupervisedStreamStats {
+  bool down = false;
+  uint64_t failures = 0;   // Errors, EOS and stalls detected
+  uint64_t reconnects = 0; // Rebuilds attempted
+  double downtime_seconds = 0.0; // Total, including the current outage
+  double retry_in_seconds = 0.0; // While down
+  std::string last_error;
+};
+
+// Watches every camera pipeline from one thread. A pipeline fails on an
+// error or EOS from its bus, or when no video buffer arrived for
+// stallTimeout. The first failure rebuilds it right away; while it stays
+// down, each further failure waits minBackoff, doubling up to maxBackoff,
+// before the next rebuild. It is up again once video buffers flow.
+class StreamSupervisor {
+public:
+  StreamSupervisor(std::chrono::milliseconds stallTimeout,
+                   std::chrono::milliseconds minBackoff,
+                   std::chrono::milliseconds maxBackoff);
+  ~StreamSupervisor();
+
+  void start();
+  void stop();
+  bool running() const;
+
+  SupervisedStreamHandle addStream(const std::string &name,
+                                   std::function<bool()> restart);
+  // Blocks until a restart of this stream in progress has finished
+  void removeStream(const SupervisedStreamHandle &stream);
+  // Safe from any thread, including GStreamer streaming threads
+  void reportFailure(const SupervisedStreamHandle &stream,
+                     const std::string &reason);
+  static void noteBuffer(SupervisedStream &stream);
+
+  SupervisedStreamStats stats(const SupervisedStreamHandle &stream) const;
+  size_t downCount() const;
+
+private:
+  void run();
+  void checkLocked(SupervisedStream &s, int64_t now,
+                   std::vector<SupervisedStreamHandle> &due,
+                   const SupervisedStreamHandle &handle);
+
+  const int64_t stall_ms_;
+  const int64_t min_backoff_ms_;
+  const int64_t max_backoff_ms_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;      // Supervisor thread waits here
+  std::condition_variable idle_cv_; // removeStream() waits here
+  std::thread thread_;
+  bool running_ = false;
+  bool wake_ = false;
+  std::vector<SupervisedStreamHandle> streams_;
+};
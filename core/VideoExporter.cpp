@@ -1,23 +1,40 @@
 #include "VideoExporter.h"
-#include <QFile>
-#include <QProcess>
-#include <QStringList>
-#include <QTextStream>
-#include <QtCore/QFile>
-#include <QtCore/QProcess>
-#include <QtCore/QTextStream>
-#include <chrono>
-#include <cstdio>
-#include <cstdlib>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/error.h>
+#include <libavutil/mathematics.h>
+}
+
+#include <algorithm>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
-#include <sstream>
+#include <string>
+#include <vector>
 
 namespace fs = std::filesystem;
 
+namespace {
+
+std::string avErrorString(int err) {
+  char buf[AV_ERROR_MAX_STRING_SIZE] = {0};
+  av_strerror(err, buf, sizeof(buf));
+  return buf;
+}
+
+// Per output stream bookkeeping across segments
+struct StreamTrack {
+  int64_t lastDts = AV_NOPTS_VALUE; // In output time base
+};
+
+} // namespace
+
 bool VideoExporter::exportSegments(
     const std::vector<std::filesystem::path> &segmentsIn,
-    const fs::path &outputFolder, const std::string &outputFilenameIn) {
+    const fs::path &outputFolder, const std::string &outputFilenameIn,
+    fs::path *outputPathOut) {
 
   if (segmentsIn.empty()) {
     std::cerr << "[VideoExporter] No segments to export.\n";
@@ -43,73 +60,195 @@ bool VideoExporter::exportSegments(
   if (fs::path(outputFilename).extension().empty())
     outputFilename += ".mkv"; // keep Matroska end-to-end
 
-  // Write concat list
-  fs::path listFile = outputFolder / "concat_list.txt";
-  QFile file(QString::fromStdString(listFile.string()));
-  if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-    std::cerr << "[VideoExporter] Failed to create concat list.\n";
+  fs::path outputPath = outputFolder / outputFilename;
+  if (!remuxSegments(segments, outputPath))
     return false;
-  }
-  auto escapeForConcat = [](const std::string &s) {
-    // concat demuxer expects: file 'path' — single quotes inside must be
-    // escaped: '\''
-    std::string out;
-    out.reserve(s.size() + 8);
-    for (char c : s) {
-      if (c == '\'')
-        out += "'\\''";
-      else
-        out += c;
-    }
-    return out;
-  };
-  QTextStream out(&file);
-  for (const auto &seg : segments) {
-    out << "file '" << QString::fromStdString(escapeForConcat(seg.string()))
-        << "'\n";
-  }
-  file.close();
 
-  // Build ffmpeg args
-  QStringList args;
-  args << "-y" << "-f" << "concat" << "-safe" << "0" << "-i"
-       << QString::fromStdString(listFile.string())
-       // Force Matroska on output if extension is .mkv (optional but explicit)
-       << "-c" << "copy";
+  std::cout << "[VideoExporter] Export completed: " << outputPath << std::endl;
 
-  fs::path outputPath = outputFolder / outputFilename;
-  if (fs::path(outputFilename).extension() == ".mkv") {
-    args << "-f" << "matroska";
-  }
-  args << QString::fromStdString(outputPath.string());
+  // Delete original segments (only if you truly want to remove them)
+  cleanupSegments(segments);
+
+  if (outputPathOut)
+    *outputPathOut = outputPath;
 
-  QProcess ffmpeg;
-  ffmpeg.start("ffmpeg", args);
-  bool started = ffmpeg.waitForStarted();
-  bool finished = ffmpeg.waitForFinished(-1);
+  return true;
+}
+
+bool VideoExporter::remuxSegments(const std::vector<fs::path> &segments,
+                                  const fs::path &outputPath) {
+  // Stream copy, same as `ffmpeg -f concat -c copy`: every segment comes from
+  // the same splitmuxsink, so they share stream layout and codec parameters.
+  // Each segment's timestamps are rebased to continue where the previous one
+  // ended.
+  const std::string outStr = outputPath.string();
+  const char *formatName =
+      outputPath.extension() == ".mkv" ? "matroska" : nullptr;
 
-  if (!started || !finished || ffmpeg.exitCode() != 0) {
-    std::cerr << "[VideoExporter] FFmpeg failed: "
-              << ffmpeg.readAllStandardError().toStdString() << std::endl;
+  AVFormatContext *out = nullptr;
+  int err = avformat_alloc_output_context2(&out, nullptr, formatName,
+                                           outStr.c_str());
+  if (err < 0 || !out) {
+    std::cerr << "[VideoExporter] Cannot create output " << outputPath << ": "
+              << avErrorString(err) << std::endl;
     return false;
   }
 
-  std::cout << "[VideoExporter] Export completed: " << outputPath << std::endl;
+  std::vector<StreamTrack> tracks;
+  bool headerWritten = false;
+  bool ok = true;
+  int64_t segmentOffset = 0; // AV_TIME_BASE units
+  AVPacket *pkt = av_packet_alloc();
 
-  // Cleanup concat list
-  QFile::remove(QString::fromStdString(listFile.string()));
+  for (const auto &seg : segments) {
+    const std::string segStr = seg.string();
+    AVFormatContext *in = nullptr;
+    err = avformat_open_input(&in, segStr.c_str(), nullptr, nullptr);
+    if (err < 0) {
+      std::cerr << "[VideoExporter] Skipping unreadable segment " << seg
+                << ": " << avErrorString(err) << std::endl;
+      continue;
+    }
+    if ((err = avformat_find_stream_info(in, nullptr)) < 0) {
+      std::cerr << "[VideoExporter] Skipping segment without stream info "
+                << seg << ": " << avErrorString(err) << std::endl;
+      avformat_close_input(&in);
+      continue;
+    }
 
-  // Delete original segments (only if you truly want to remove them)
-  cleanupSegments(segments);
+    // The first readable segment defines the output streams
+    if (!headerWritten) {
+      for (unsigned i = 0; i < in->nb_streams; ++i) {
+        AVStream *os = avformat_new_stream(out, nullptr);
+        if (!os ||
+            avcodec_parameters_copy(os->codecpar, in->streams[i]->codecpar) <
+                0) {
+          ok = false;
+          break;
+        }
+        os->codecpar->codec_tag = 0; // Let the muxer pick its own tag
+        os->time_base = in->streams[i]->time_base;
+      }
+      tracks.assign(out->nb_streams, StreamTrack{});
 
-  return true;
+      if (ok && !(out->oformat->flags & AVFMT_NOFILE)) {
+        err = avio_open(&out->pb, outStr.c_str(), AVIO_FLAG_WRITE);
+        if (err < 0) {
+          std::cerr << "[VideoExporter] Cannot open " << outputPath << ": "
+                    << avErrorString(err) << std::endl;
+          ok = false;
+        }
+      }
+      if (ok && (err = avformat_write_header(out, nullptr)) < 0) {
+        std::cerr << "[VideoExporter] Failed to write header: "
+                  << avErrorString(err) << std::endl;
+        ok = false;
+      }
+      if (!ok) {
+        avformat_close_input(&in);
+        break;
+      }
+      headerWritten = true;
+    }
+
+    // Segment start: earliest timestamp across its streams
+    int64_t segmentStart = AV_NOPTS_VALUE;
+    for (unsigned i = 0; i < in->nb_streams; ++i) {
+      const AVStream *is = in->streams[i];
+      if (is->start_time == AV_NOPTS_VALUE)
+        continue;
+      int64_t st =
+          av_rescale_q(is->start_time, is->time_base, AV_TIME_BASE_Q);
+      if (segmentStart == AV_NOPTS_VALUE || st < segmentStart)
+        segmentStart = st;
+    }
+    if (segmentStart == AV_NOPTS_VALUE)
+      segmentStart = 0;
+
+    int64_t segmentEnd = segmentOffset;
+    while ((err = av_read_frame(in, pkt)) >= 0) {
+      unsigned idx = static_cast<unsigned>(pkt->stream_index);
+      if (idx >= out->nb_streams ||
+          in->streams[idx]->codecpar->codec_type !=
+              out->streams[idx]->codecpar->codec_type) {
+        av_packet_unref(pkt);
+        continue;
+      }
+
+      AVRational inTb = in->streams[idx]->time_base;
+      AVRational outTb = out->streams[idx]->time_base;
+      int64_t shift = av_rescale_q(segmentOffset - segmentStart,
+                                   AV_TIME_BASE_Q, inTb);
+      if (pkt->pts != AV_NOPTS_VALUE)
+        pkt->pts += shift;
+      if (pkt->dts != AV_NOPTS_VALUE)
+        pkt->dts += shift;
+      av_packet_rescale_ts(pkt, inTb, outTb);
+
+      // Keep dts strictly increasing across the segment boundary
+      StreamTrack &track = tracks[idx];
+      if (pkt->dts != AV_NOPTS_VALUE) {
+        if (track.lastDts != AV_NOPTS_VALUE && pkt->dts <= track.lastDts)
+          pkt->dts = track.lastDts + 1;
+        if (pkt->pts != AV_NOPTS_VALUE && pkt->pts < pkt->dts)
+          pkt->pts = pkt->dts;
+        track.lastDts = pkt->dts;
+      }
+
+      int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+      if (ts != AV_NOPTS_VALUE)
+        segmentEnd = std::max(
+            segmentEnd,
+            av_rescale_q(ts + std::max<int64_t>(pkt->duration, 0), outTb,
+                         AV_TIME_BASE_Q));
+
+      pkt->pos = -1;
+      err = av_interleaved_write_frame(out, pkt);
+      av_packet_unref(pkt);
+      if (err < 0) {
+        std::cerr << "[VideoExporter] Write failed: " << avErrorString(err)
+                  << std::endl;
+        ok = false;
+        break;
+      }
+    }
+    avformat_close_input(&in);
+    if (!ok)
+      break;
+
+    segmentOffset = segmentEnd;
+  }
+
+  av_packet_free(&pkt);
+
+  if (ok && !headerWritten) {
+    std::cerr << "[VideoExporter] No readable segments." << std::endl;
+    ok = false;
+  }
+  if (headerWritten) {
+    err = av_write_trailer(out);
+    if (err < 0) {
+      std::cerr << "[VideoExporter] Failed to write trailer: "
+                << avErrorString(err) << std::endl;
+      ok = false;
+    }
+  }
+  if (out->pb && !(out->oformat->flags & AVFMT_NOFILE))
+    avio_closep(&out->pb);
+  avformat_free_context(out);
+
+  if (!ok) {
+    std::error_code ec;
+    fs::remove(outputPath, ec);
+  }
+  return ok;
 }
 
 void VideoExporter::cleanupSegments(
     const std::vector<std::filesystem::path> &segments) {
   for (const auto &seg : segments) {
-    QFile qfile(QString::fromStdString(seg.string()));
-    if (!qfile.remove()) {
+    std::error_code ec;
+    if (!fs::remove(seg, ec)) {
       std::cerr << "[VideoExporter] Failed to delete: " << seg << std::endl;
     } else {
       std::cout << "[VideoExporter] Deleted: " << seg << std::endl;
@@ -8,12 +8,18 @@
 class VideoExporter {
 public:
   // Exports all segments (including and before lastSavedSegment) into
-  // outputFilename
+  // outputFilename. On success the written file is stored in outputPath if
+  // given.
   static bool exportSegments(const std::vector<std::filesystem::path> &segments,
                              const std::filesystem::path &outputFolder,
-                             const std::string &outputFilename);
+                             const std::string &outputFilename,
+                             std::filesystem::path *outputPath = nullptr);
 
 private:
+  // Stream-copies the segments, in order, into one file with continuous
+  // timestamps (libavformat, no external process or concat list)
+  static bool remuxSegments(const std::vector<std::filesystem::path> &segments,
+                            const std::filesystem::path &outputPath);
   static void
   cleanupSegments(const std::vector<std::filesystem::path> &segments);
 };
@@ -1,4 +0,0 @@
-// Intentionally empty.
-// Keeping the operator<< inline in the header avoids multiple-definition
-// issues. You may include this file in your build to keep the pair consistent.
-#include "conversations.h"
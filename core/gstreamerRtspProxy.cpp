@@ -1,4 +1,5 @@
 #include "gstreamerRtspProxy.h"
+#include "GstRuntime.h"
 
 #include <iostream>
 
@@ -23,17 +24,14 @@ bool GstreamerRtspProxy::start(int port) {
   if (rtsp_running_.load())
     return true;
 
-  main_loop_ = g_main_loop_new(nullptr, FALSE);
-  if (!main_loop_) {
-    std::cerr << "GstreamerRtspProxy: Failed to create GLib main loop\n";
+  if (!runtime_) {
+    std::cerr << "GstreamerRtspProxy: start() called without a GstRuntime\n";
     return false;
   }
 
   rtsp_server_ = gst_rtsp_server_new();
   if (!rtsp_server_) {
     std::cerr << "GstreamerRtspProxy: Failed to create RTSP server\n";
-    g_main_loop_unref(main_loop_);
-    main_loop_ = nullptr;
     return false;
   }
 
@@ -44,27 +42,30 @@ bool GstreamerRtspProxy::start(int port) {
     std::cerr << "GstreamerRtspProxy: Failed to get RTSP mount points\n";
     g_object_unref(rtsp_server_);
     rtsp_server_ = nullptr;
-    g_main_loop_unref(main_loop_);
-    main_loop_ = nullptr;
     return false;
   }
 
-  // Attach the server to default main context; keep source id implicit.
-  if (gst_rtsp_server_attach(rtsp_server_, nullptr) == 0) {
-    std::cerr << "GstreamerRtspProxy: Failed to attach RTSP server\n";
+  // Listen on the shared runtime context instead of a loop of our own.
+  // Client connections still get threads from the server's thread pool.
+  GError *err = nullptr;
+  server_source_ = gst_rtsp_server_create_source(rtsp_server_, nullptr, &err);
+  if (!server_source_) {
+    std::cerr << "GstreamerRtspProxy: Failed to attach RTSP server: "
+              << (err ? err->message : "unknown error") << "\n";
+    if (err)
+      g_error_free(err);
     g_object_unref(mounts_);
     mounts_ = nullptr;
     g_object_unref(rtsp_server_);
     rtsp_server_ = nullptr;
-    g_main_loop_unref(main_loop_);
-    main_loop_ = nullptr;
     return false;
   }
+  runtime_->attach(server_source_);
+  g_source_unref(server_source_); // The runtime holds it until remove()
 
   std::cout << "RTSP proxy server started at " << endpoint() << std::endl;
 
   rtsp_running_.store(true);
-  rtsp_thread_ = std::thread(&GstreamerRtspProxy::threadFunc_, this);
   return true;
 }
 
@@ -109,10 +110,9 @@ void GstreamerRtspProxy::stop() {
   if (!wasRunning)
     return;
 
-  if (main_loop_)
-    g_main_loop_quit(main_loop_);
-  if (rtsp_thread_.joinable())
-    rtsp_thread_.join();
+  // Waits for a dispatch of the server source in progress
+  runtime_->remove(server_source_);
+  server_source_ = nullptr;
 
   // Unref in reverse order of acquisition
   if (mounts_) {
@@ -123,23 +123,10 @@ void GstreamerRtspProxy::stop() {
     g_object_unref(rtsp_server_);
     rtsp_server_ = nullptr;
   }
-  if (main_loop_) {
-    g_main_loop_unref(main_loop_);
-    main_loop_ = nullptr;
-  }
 
   std::cout << "RTSP proxy server stopped." << std::endl;
 }
 
-void GstreamerRtspProxy::threadFunc_() {
-  if (!main_loop_)
-    return;
-  g_main_loop_run(main_loop_);
-  // After g_main_loop_quit(), we land here:
-  // Nothing else to do; cleanup handled in stop().
-  std::cout << "RTSP server loop exited." << std::endl;
-}
-
 std::string GstreamerRtspProxy::endpoint() const {
   // We don’t set address here (defaults to any). Use loopback in message.
   return "rtsp://127.0.0.1:" + std::to_string(port_) + "/";
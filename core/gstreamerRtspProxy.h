@@ -2,18 +2,23 @@
 
 #include <atomic>
 #include <string>
-#include <thread>
 
 // GStreamer / RTSP
 #include <gst/gst.h>
 #include <gst/rtsp-server/rtsp-server.h>
 
+class GstRuntime;
+
 class GstreamerRtspProxy {
 public:
   GstreamerRtspProxy();
   ~GstreamerRtspProxy();
 
-  // Start the RTSP server and main loop thread.
+  // The server's socket source runs on this runtime's main context; set it
+  // before start()
+  void setRuntime(GstRuntime *runtime) { runtime_ = runtime; }
+
+  // Start the RTSP server on the runtime's main context.
   // Returns true on success. Default port 8554.
   bool start(int port = 8554);
 
@@ -22,7 +27,7 @@ public:
   bool addCameraProxy(const std::string &camName, int bitrate,
                       const std::string &speedPreset);
 
-  // Stop server and join thread.
+  // Detach the server from the runtime and release it.
   void stop();
 
   bool isRunning() const { return rtsp_running_.load(); }
@@ -30,15 +35,13 @@ public:
   bool removeCameraProxy(const std::string &camName);
 
 private:
-  void threadFunc_();
-
   std::atomic<int> mount_count_{0};
 
-  GMainLoop *main_loop_ = nullptr;
+  GstRuntime *runtime_ = nullptr;
+  GSource *server_source_ = nullptr;
   GstRTSPServer *rtsp_server_ = nullptr;
   GstRTSPMountPoints *mounts_ = nullptr;
 
-  std::thread rtsp_thread_;
   std::atomic<bool> rtsp_running_{false};
   int port_ = 8554;
 };
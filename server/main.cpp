@@ -1,8 +1,10 @@
 #include "CameraManager.h"
 #include "Settings.h"
 #include "httplib.h"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
 #include <memory>
@@ -15,6 +17,20 @@
 using Clock = std::chrono::steady_clock;
 using nlohmann::json;
 
+// Unix time in seconds (fractions allowed) to a system clock time point
+bool parseUnixTime(const std::string &s,
+                   std::chrono::system_clock::time_point &out) {
+  try {
+    double seconds = std::stod(s);
+    out = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::duration<double>(seconds)));
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
 // Helper function to translate localhost to host.docker.internal when running
 // in Docker
 std::string translateDockerUri(const std::string &uri) {
@@ -67,6 +83,9 @@ int main() {
 
   CameraManager manager(settings);
 
+  // Open /motion_stream responses (outlives svr, which owns them)
+  std::atomic<int> activeMotionStreams{0};
+
   httplib::Server svr;
 
   // HTTP request logging toggle (default OFF)
@@ -143,6 +162,26 @@ int main() {
             res.set_content(j.dump(2), "application/json");
           });
 
+  // Probe RTSP URIs ahead of adding them: ?uri=...&uri=... are probed
+  // concurrently and cached, so the /add_camera calls that follow don't
+  // each wait on a DESCRIBE
+  svr.Post("/probe_streams",
+           [&](const httplib::Request &req, httplib::Response &res) {
+             size_t n = req.get_param_value_count("uri");
+             if (n == 0) {
+               res.status = 400;
+               res.set_content("Missing required parameter: uri",
+                               "text/plain");
+               return;
+             }
+             std::vector<std::string> uris;
+             for (size_t i = 0; i < n; ++i)
+               uris.push_back(
+                   translateDockerUri(req.get_param_value("uri", i)));
+             auto j = manager.probeStreamsJson(uris);
+             res.set_content(j.dump(2), "application/json");
+           });
+
   // Add camera
   svr.Post("/add_camera", [&](const httplib::Request &req,
                               httplib::Response &res) {
@@ -163,6 +202,8 @@ int main() {
     bool recording = param_to_bool("recording");
     bool overlay = param_to_bool("overlay");
     bool motion_frame = param_to_bool("motion_frame");
+    bool preroll_recording = param_to_bool("preroll_recording");
+    bool segment_on_motion = param_to_bool("segment_on_motion");
     bool gstreamerEncodedProxy = param_to_bool("gstreamerEncodedProxy");
     bool live555proxied =
         param_to_bool("live555proxied") || param_to_bool("live555proxy");
@@ -243,18 +284,36 @@ int main() {
             ? std::stoi(req.get_param_value("motion_arrow_thickness"))
             : settings.motion_arrow_thickness();
 
+    int motion_fps = req.has_param("motion_fps")
+                         ? std::stoi(req.get_param_value("motion_fps"))
+                         : settings.motion_fps();
+
+    MotionDecodeMode motion_decode_mode = motionDecodeModeFromString(
+        req.has_param("motion_decode_mode")
+            ? req.get_param_value("motion_decode_mode")
+            : settings.motion_decode_mode());
+
     std::string video_output_format =
         req.has_param("video_output_format")
             ? req.get_param_value("video_output_format")
             : settings.video_output_format();
 
-    manager.addCamera(name, uri, segment, recording, overlay, motion_frame,
-                      gstreamerEncodedProxy, live555proxied,
-                      /*loading=*/false, segment_bitrate, segment_speed_preset,
-                      proxy_bitrate, proxy_speed_preset, motion_frame_size,
-                      motion_frame_scale, noise_threshold, motion_threshold,
-                      motion_min_hits, motion_decay, motion_arrow_scale,
-                      motion_arrow_thickness, video_output_format);
+    bool added = manager.addCamera(
+        name, uri, segment, recording, overlay, motion_frame,
+        gstreamerEncodedProxy, live555proxied,
+        /*loading=*/false, segment_bitrate, segment_speed_preset,
+        proxy_bitrate, proxy_speed_preset, motion_frame_size,
+        motion_frame_scale, noise_threshold, motion_threshold,
+        motion_min_hits, motion_decay, motion_arrow_scale,
+        motion_arrow_thickness, motion_fps, motion_decode_mode,
+        preroll_recording, segment_on_motion, video_output_format);
+    if (!added) {
+      res.status = 409;
+      res.set_content("Camera '" + name +
+                          "' already exists or is still starting",
+                      "text/plain");
+      return;
+    }
 
     std::ostringstream msg;
     msg << "Camera added (" << "segment=" << segment
@@ -275,6 +334,10 @@ int main() {
         << ", motion_decay=" << motion_decay
         << ", motion_arrow_scale=" << motion_arrow_scale
         << ", motion_arrow_thickness=" << motion_arrow_thickness
+        << ", motion_fps=" << motion_fps << ", motion_decode_mode="
+        << motionDecodeModeToString(motion_decode_mode)
+        << ", preroll_recording=" << preroll_recording
+        << ", segment_on_motion=" << segment_on_motion
         << ", video_output_format=" << video_output_format << ")\n";
     res.set_content(msg.str(), "text/plain");
   });
@@ -295,26 +358,125 @@ int main() {
               res.set_content("Camera not found", "text/plain");
               return;
             }
-            const cv::Mat &frame = cam->getLastMotionFrame();
-            if (frame.empty()) {
+            auto snap = cam->getMotionSnapshot();
+            if (!snap || snap->frame().empty()) {
               res.status = 404;
               res.set_content("No motion frame available", "text/plain");
               return;
             }
 
-            // Encode to JPEG in-memory
-            std::vector<uchar> buf;
-            if (!cv::imencode(".jpg", frame, buf)) {
+            // Encoded once per frame and shared by all clients polling it
+            const std::vector<uchar> &buf = snap->jpeg();
+            if (buf.empty()) {
               res.status = 500;
               res.set_content("Failed to encode image", "text/plain");
               return;
             }
 
             // Send as JPEG
+            res.set_header("X-Motion-Seq", std::to_string(snap->seq()));
             res.set_content(reinterpret_cast<const char *>(buf.data()),
                             buf.size(), "image/jpeg");
           });
 
+  svr.Get("/motion_stream", [&](const httplib::Request &req,
+                                httplib::Response &res) {
+    // Example: /motion_stream?name=cam1&fps=5
+    // Pushes each new motion frame as a multipart/x-mixed-replace JPEG part
+    // over one long-lived response instead of one request per frame
+    if (!req.has_param("name")) {
+      res.status = 400;
+      res.set_content("Missing required parameter: name", "text/plain");
+      return;
+    }
+    std::string name = req.get_param_value("name");
+    if (!manager.getCamera(name)) {
+      res.status = 404;
+      res.set_content("Camera not found", "text/plain");
+      return;
+    }
+
+    double fps = 5.0;
+    if (req.has_param("fps")) {
+      try {
+        fps = std::stod(req.get_param_value("fps"));
+      } catch (...) {
+        res.status = 400;
+        res.set_content("Invalid fps", "text/plain");
+        return;
+      }
+    }
+    fps = std::clamp(fps, 0.2, 30.0);
+
+    // Each stream keeps one HTTP worker busy for as long as it is open, so
+    // cap them below the server's thread pool
+    const int maxStreams = std::max(1, settings.motion_stream_max_clients());
+    if (activeMotionStreams.fetch_add(1) >= maxStreams) {
+      activeMotionStreams.fetch_sub(1);
+      res.status = 503;
+      res.set_header("Retry-After", "5");
+      res.set_content("Too many motion streams", "text/plain");
+      return;
+    }
+
+    struct StreamState {
+      explicit StreamState(std::atomic<int> &active) : active(active) {}
+      ~StreamState() { active.fetch_sub(1); } // Stream closed, free the slot
+      std::atomic<int> &active;
+      uint64_t last_seq = 0;
+      Clock::time_point next_send;
+    };
+    auto state = std::make_shared<StreamState>(activeMotionStreams);
+    auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / fps));
+    const std::string boundary = "motionframe";
+
+    res.set_header("Cache-Control", "no-cache");
+    res.set_chunked_content_provider(
+        "multipart/x-mixed-replace; boundary=" + boundary,
+        [&manager, name, period, boundary,
+         state](size_t, httplib::DataSink &sink) {
+          // Rate limit, then wait for a frame newer than the last one sent
+          std::this_thread::sleep_until(state->next_send);
+
+          std::shared_ptr<const MotionSnapshot> snap;
+          while (true) {
+            if (!sink.is_writable())
+              return false;
+            // Camera removed: end the stream
+            if (!manager.getMotionSnapshot(name, snap)) {
+              sink.done();
+              return true;
+            }
+            if (snap && snap->seq() != state->last_seq)
+              break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+          }
+
+          const std::vector<uchar> &buf = snap->jpeg();
+          if (buf.empty()) {
+            state->last_seq = snap->seq();
+            return true;
+          }
+
+          std::string header = "--" + boundary +
+                               "\r\nContent-Type: image/jpeg"
+                               "\r\nContent-Length: " +
+                               std::to_string(buf.size()) +
+                               "\r\nX-Motion-Seq: " +
+                               std::to_string(snap->seq()) + "\r\n\r\n";
+          if (!sink.write(header.data(), header.size()) ||
+              !sink.write(reinterpret_cast<const char *>(buf.data()),
+                          buf.size()) ||
+              !sink.write("\r\n", 2))
+            return false;
+
+          state->last_seq = snap->seq();
+          state->next_send = Clock::now() + period;
+          return true;
+        });
+  });
+
   svr.Get("/favicon.ico",
           [](const httplib::Request &req, httplib::Response &res) {
             res.status = 204; // No Content
@@ -353,13 +515,12 @@ int main() {
              }
            });
 
-  // Enable/disable full recording
+  // Enable/disable continuous recording
   svr.Post("/record_on",
            [&](const httplib::Request &req, httplib::Response &res) {
              auto name = req.get_param_value("name");
-             auto file = req.get_param_value("file");
              if (auto cam = manager.getCamera(name)) {
-               cam->enableFullRecording(file);
+               cam->enableFullRecording();
                manager.saveSingleCameraToJSON(manager.config_path_, name);
                res.set_content("Full recording ON\n", "text/plain");
              } else {
@@ -380,6 +541,90 @@ int main() {
              }
            });
 
+  // Find the keyframe at or before a wall-clock time in the continuous
+  // recording, straight from the on-disk index
+  svr.Get("/recording/seek", [&](const httplib::Request &req,
+                                 httplib::Response &res) {
+    // Example: /recording/seek?name=cam1&time=1760600000 (Unix seconds)
+    if (!req.has_param("name") || !req.has_param("time")) {
+      res.status = 400;
+      res.set_content("Missing required parameters: name, time", "text/plain");
+      return;
+    }
+    CameraStream *cam = manager.getCamera(req.get_param_value("name"));
+    if (!cam) {
+      res.status = 404;
+      res.set_content("Camera not found", "text/plain");
+      return;
+    }
+
+    std::chrono::system_clock::time_point when;
+    if (!parseUnixTime(req.get_param_value("time"), when)) {
+      res.status = 400;
+      res.set_content("Invalid time", "text/plain");
+      return;
+    }
+
+    RecordingPosition pos;
+    if (!ContinuousRecorder::seek(cam->recordingRoot(), when, pos)) {
+      res.status = 404;
+      res.set_content("No recording at that time", "text/plain");
+      return;
+    }
+
+    json j;
+    j["file"] = pos.file.lexically_relative(cam->recordingRoot()).string();
+    j["offset"] = pos.offset;
+    j["keyframe_time"] = pos.keyframe_ms / 1000.0;
+    res.set_content(j.dump(2), "application/json");
+  });
+
+  // MPEG-TS from the keyframe at or before `time` to the end of its file
+  svr.Get("/recording/stream", [&](const httplib::Request &req,
+                                   httplib::Response &res) {
+    if (!req.has_param("name") || !req.has_param("time")) {
+      res.status = 400;
+      res.set_content("Missing required parameters: name, time", "text/plain");
+      return;
+    }
+    CameraStream *cam = manager.getCamera(req.get_param_value("name"));
+    if (!cam) {
+      res.status = 404;
+      res.set_content("Camera not found", "text/plain");
+      return;
+    }
+
+    std::chrono::system_clock::time_point when;
+    if (!parseUnixTime(req.get_param_value("time"), when)) {
+      res.status = 400;
+      res.set_content("Invalid time", "text/plain");
+      return;
+    }
+
+    RecordingPosition pos;
+    std::shared_ptr<std::FILE> file;
+    if (ContinuousRecorder::seek(cam->recordingRoot(), when, pos))
+      file.reset(std::fopen(pos.file.string().c_str(), "rb"), std::fclose);
+    if (!file ||
+        std::fseek(file.get(), static_cast<long>(pos.offset), SEEK_SET) != 0) {
+      res.status = 404;
+      res.set_content("No recording at that time", "text/plain");
+      return;
+    }
+
+    res.set_header("X-Keyframe-Time", std::to_string(pos.keyframe_ms / 1000.0));
+    res.set_chunked_content_provider(
+        "video/mp2t", [file](size_t, httplib::DataSink &sink) {
+          char buf[188 * 348]; // ~64 KiB of whole TS packets
+          size_t n = std::fread(buf, 1, sizeof(buf), file.get());
+          if (n > 0 && !sink.write(buf, n))
+            return false;
+          if (n < sizeof(buf))
+            sink.done();
+          return true;
+        });
+  });
+
   // Enable/disable overlay
   svr.Post("/overlay_on",
            [&](const httplib::Request &req, httplib::Response &res) {
@@ -668,6 +913,95 @@ int main() {
       }
     }
 
+    // Update feature_redetect_interval (frames between full re-detection)
+    if (req.has_param("feature_redetect_interval")) {
+      try {
+        int value = std::stoi(req.get_param_value("feature_redetect_interval"));
+        cam->setFeatureRedetectInterval(value);
+        response["updated_properties"].push_back("feature_redetect_interval");
+        updated = true;
+      } catch (...) {
+        response["errors"].push_back("Invalid feature_redetect_interval value");
+      }
+    }
+
+    // Update feature_min_survivor_ratio (re-detect below this tracked ratio)
+    if (req.has_param("feature_min_survivor_ratio")) {
+      try {
+        float value =
+            std::stof(req.get_param_value("feature_min_survivor_ratio"));
+        cam->setFeatureMinSurvivorRatio(value);
+        response["updated_properties"].push_back("feature_min_survivor_ratio");
+        updated = true;
+      } catch (...) {
+        response["errors"].push_back(
+            "Invalid feature_min_survivor_ratio value");
+      }
+    }
+
+    // Update diff_gate_ratio (fraction of changed pixels to run optical flow)
+    if (req.has_param("diff_gate_ratio")) {
+      try {
+        float value = std::stof(req.get_param_value("diff_gate_ratio"));
+        cam->setDiffGateRatio(value);
+        response["updated_properties"].push_back("diff_gate_ratio");
+        updated = true;
+      } catch (...) {
+        response["errors"].push_back("Invalid diff_gate_ratio value");
+      }
+    }
+
+    // Update diff_gate_pixel_threshold (per-pixel intensity delta)
+    if (req.has_param("diff_gate_pixel_threshold")) {
+      try {
+        int value = std::stoi(req.get_param_value("diff_gate_pixel_threshold"));
+        cam->setDiffGatePixelThreshold(value);
+        response["updated_properties"].push_back("diff_gate_pixel_threshold");
+        updated = true;
+      } catch (...) {
+        response["errors"].push_back("Invalid diff_gate_pixel_threshold value");
+      }
+    }
+
+    // Update motion_fps (analysis rate cap, rebuilds the pipeline)
+    if (req.has_param("motion_fps")) {
+      try {
+        int value = std::stoi(req.get_param_value("motion_fps"));
+        cam->setMotionFps(value);
+        response["updated_properties"].push_back("motion_fps");
+        updated = true;
+      } catch (...) {
+        response["errors"].push_back("Invalid motion_fps value");
+      }
+    }
+
+    // Update motion_decode_mode (full/nonref/keyframe, rebuilds the pipeline)
+    if (req.has_param("motion_decode_mode")) {
+      std::string value = req.get_param_value("motion_decode_mode");
+      if (value == "full" || value == "nonref" || value == "keyframe") {
+        cam->setMotionDecodeMode(motionDecodeModeFromString(value));
+        response["updated_properties"].push_back("motion_decode_mode");
+        updated = true;
+      } else {
+        response["errors"].push_back("Invalid motion_decode_mode value");
+      }
+    }
+
+    // Update motion_engine (optical_flow/bg_subtract/frame_diff/
+    // motion_vectors, takes effect on the next motion frame; motion_vectors
+    // rebuilds the pipeline)
+    if (req.has_param("motion_engine")) {
+      std::string value = req.get_param_value("motion_engine");
+      if (value == "optical_flow" || value == "bg_subtract" ||
+          value == "frame_diff" || value == "motion_vectors") {
+        cam->setMotionEngine(motionEngineFromString(value));
+        response["updated_properties"].push_back("motion_engine");
+        updated = true;
+      } else {
+        response["errors"].push_back("Invalid motion_engine value");
+      }
+    }
+
     // Update motion_frame_size (width and height)
     if (req.has_param("motion_frame_width") &&
         req.has_param("motion_frame_height")) {
@@ -703,6 +1037,42 @@ int main() {
       }
     }
 
+    // Toggle pre-roll motion clips (in-memory ring, rebuilds the pipeline)
+    if (req.has_param("preroll_recording")) {
+      try {
+        std::string value = req.get_param_value("preroll_recording");
+        bool enable = (value == "1" || value == "true" || value == "on");
+
+        if (enable)
+          cam->enablePrerollRecording();
+        else
+          cam->disablePrerollRecording();
+        response["updated_properties"].push_back("preroll_recording");
+        response["preroll_recording"] = enable;
+        updated = true;
+      } catch (...) {
+        response["errors"].push_back("Invalid preroll_recording value");
+      }
+    }
+
+    // Record-on-motion-only segments (gated branch, rebuilds the pipeline)
+    if (req.has_param("segment_on_motion")) {
+      try {
+        std::string value = req.get_param_value("segment_on_motion");
+        bool enable = (value == "1" || value == "true" || value == "on");
+
+        if (enable)
+          cam->enableSegmentOnMotion();
+        else
+          cam->disableSegmentOnMotion();
+        response["updated_properties"].push_back("segment_on_motion");
+        response["segment_on_motion"] = enable;
+        updated = true;
+      } catch (...) {
+        response["errors"].push_back("Invalid segment_on_motion value");
+      }
+    }
+
     if (updated) {
       manager.saveSingleCameraToJSON(manager.config_path_, name);
       response["message"] = "Camera properties updated and saved";
@@ -713,6 +1083,25 @@ int main() {
     res.set_content(response.dump(), "application/json");
   });
 
+  // Per-camera motion loop counters
+  svr.Get("/motion_stats",
+          [&](const httplib::Request &, httplib::Response &res) {
+            auto j = manager.getMotionStatsJson();
+            res.set_content(j.dump(2), "application/json");
+          });
+
+  svr.Get("/export_stats",
+          [&](const httplib::Request &, httplib::Response &res) {
+            auto j = manager.getExportStatsJson();
+            res.set_content(j.dump(2), "application/json");
+          });
+
+  // Recording disk usage per camera and retention quotas
+  svr.Get("/storage", [&](const httplib::Request &, httplib::Response &res) {
+    auto j = manager.getStorageJson();
+    res.set_content(j.dump(2), "application/json");
+  });
+
   // Thread info endpoint
   svr.Get("/threads", [&](const httplib::Request &, httplib::Response &res) {
     json threads_array = json::array();
@@ -726,13 +1115,20 @@ int main() {
       if (!cam)
         continue;
 
-      // Motion detection thread
+      // Motion detection (runs on the shared pool below)
       json motion_thread;
       motion_thread["name"] = "Motion: " + cam_name;
       motion_thread["is_active"] =
           cam->motion_frame(); // Active if motion enabled
-      motion_thread["details"] =
-          cam->motion_frame() ? "Processing motion frames" : "Disabled";
+      if (cam->motion_frame()) {
+        const MotionStats st = cam->motionStats();
+        motion_thread["details"] =
+            "Scheduled on motion pool (analyzed " +
+            std::to_string(st.frames_analyzed) + ", gated " +
+            std::to_string(st.frames_gated) + ")";
+      } else {
+        motion_thread["details"] = "Disabled";
+      }
       threads_array.push_back(motion_thread);
 
       // Segment worker thread (only if segmentation is enabled)
@@ -740,12 +1136,66 @@ int main() {
         json segment_thread;
         segment_thread["name"] = "Segment: " + cam_name;
         segment_thread["is_active"] = true;
-        segment_thread["details"] = "Monitoring segment directory";
+        segment_thread["details"] = "Waiting for splitmuxsink fragments";
         threads_array.push_back(segment_thread);
       }
     }
 
-    // GStreamer RTSP proxy thread (if any cameras use it)
+    // Shared motion analysis pool
+    const auto workers = manager.motionScheduler().workerStats();
+    for (size_t i = 0; i < workers.size(); ++i) {
+      const auto &w = workers[i];
+      json worker_thread;
+      worker_thread["name"] = "Motion worker " + std::to_string(i);
+      worker_thread["is_active"] = w.busy;
+      worker_thread["details"] =
+          (w.busy ? "Analyzing " + w.current : std::string("Idle")) +
+          " (runs " + std::to_string(w.tasks_run) + ", steals " +
+          std::to_string(w.steals) + ", pool size " +
+          std::to_string(workers.size()) + ")";
+      threads_array.push_back(worker_thread);
+    }
+
+    // Motion clip export pool
+    const auto exporters = manager.exportScheduler().workerStats();
+    const ExportStats export_stats = manager.exportScheduler().stats();
+    for (size_t i = 0; i < exporters.size(); ++i) {
+      const auto &w = exporters[i];
+      json export_thread;
+      export_thread["name"] = "Export worker " + std::to_string(i);
+      export_thread["is_active"] = w.busy;
+      export_thread["details"] =
+          (w.busy ? "Exporting " + w.current : std::string("Idle")) +
+          " (queued " + std::to_string(export_stats.queue_depth) + "/" +
+          std::to_string(export_stats.queue_limit) + ")";
+      threads_array.push_back(export_thread);
+    }
+
+    // Retention service (indexes recordings, evicts over quota)
+    {
+      const RetentionUsage usage = manager.retention().usage();
+      json retention_thread;
+      retention_thread["name"] = "Retention";
+      retention_thread["is_active"] = manager.retention().running();
+      retention_thread["details"] =
+          std::to_string(usage.files) + " recordings, " +
+          std::to_string(usage.bytes / (1024 * 1024)) + " MB indexed";
+      threads_array.push_back(retention_thread);
+    }
+
+    // Pipeline supervisor (reconnects dead or stalled cameras)
+    {
+      json supervisor_thread;
+      supervisor_thread["name"] = "Supervisor";
+      supervisor_thread["is_active"] = manager.supervisor().running();
+      supervisor_thread["details"] =
+          std::to_string(manager.supervisor().downCount()) +
+          " cameras reconnecting";
+      threads_array.push_back(supervisor_thread);
+    }
+
+    // Shared GLib main context: camera bus watches and the GStreamer RTSP
+    // proxy server (if any cameras use it)
     bool has_gst_proxy = false;
     for (const auto &cam_name : camera_names) {
       auto *cam = manager.getCamera(cam_name);
@@ -754,13 +1204,19 @@ int main() {
         break;
       }
     }
-    if (has_gst_proxy) {
+    {
+      const GstRuntime &runtime = manager.gstRuntime();
+      std::string details =
+          std::to_string(runtime.sourceCount()) + " sources, " +
+          std::to_string(static_cast<long long>(runtime.threadCpuMs())) +
+          " ms CPU";
+      if (has_gst_proxy)
+        details += ", RTSP proxy (port " +
+                   std::to_string(settings.live_rtsp_proxy_port()) + ")";
       json gst_thread;
-      gst_thread["name"] = "GStreamer RTSP Proxy";
-      gst_thread["is_active"] = true;
-      gst_thread["details"] = "GLib main loop (port " +
-                              std::to_string(settings.live_rtsp_proxy_port()) +
-                              ")";
+      gst_thread["name"] = "GLib Runtime";
+      gst_thread["is_active"] = runtime.running();
+      gst_thread["details"] = details;
       threads_array.push_back(gst_thread);
     }
 
@@ -0,0 +1,248 @@
+// Offline benchmark of the motion vector engine against optical flow on
+// recorded H.264 clips, e.g. media/<camera>/continuous/.../*.ts. Each clip
+// is decoded once; every frame with motion vectors is then scored by both
+// engines on the same input. Prints the cost per frame and how often the
+// two agree on motion (score above motion_threshold).
+//
+//   motionbench [--settings settings.json] [--size WxH] clip...
+//
+// Engine tuning (thresholds, fallback band) comes from the settings file.
+// The frame-difference pre-gate is left out, so optical flow runs on every
+// frame: the cost of a busy scene. Both engines see the motion vector
+// decoder's luma.
+
+#include "MotionDetector.h"
+#include "MotionVectorDecoder.h"
+#include "Settings.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <opencv2/imgproc.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+
+using BenchClock = std::chrono::steady_clock;
+
+double elapsedMs(BenchClock::time_point since) {
+  return std::chrono::duration<double, std::milli>(BenchClock::now() - since)
+      .count();
+}
+
+struct EngineRun {
+  double ms = 0.0;      // analyze() only
+  int motionFrames = 0; // Score above motion_threshold
+  int fallbacks = 0;    // Motion vectors: optical flow decided
+};
+
+struct BenchReport {
+  int frames = 0; // Decoded
+  int scored = 0; // Had motion vectors, scored by both engines
+  double decodeMs = 0.0;
+  double prepareMs = 0.0; // Luma to analysis size, for optical flow
+  EngineRun flow, vectors;
+  int agree = 0;
+
+  void add(const BenchReport &o) {
+    frames += o.frames;
+    scored += o.scored;
+    decodeMs += o.decodeMs;
+    prepareMs += o.prepareMs;
+    flow.ms += o.flow.ms;
+    flow.motionFrames += o.flow.motionFrames;
+    vectors.ms += o.vectors.ms;
+    vectors.motionFrames += o.vectors.motionFrames;
+    vectors.fallbacks += o.vectors.fallbacks;
+    agree += o.agree;
+  }
+};
+
+void runEngine(MotionDetector &detector, const MotionDetectorInput &in,
+               MotionDetectorResult &result, float threshold,
+               EngineRun &run) {
+  const auto start = BenchClock::now();
+  detector.analyze(in, result);
+  run.ms += elapsedMs(start);
+  if (result.motion > threshold)
+    ++run.motionFrames;
+  if (result.fallback)
+    ++run.fallbacks;
+}
+
+bool benchClip(const std::string &path, const Settings &settings,
+               const cv::Size &size, BenchReport &report) {
+  AVFormatContext *fmt = nullptr;
+  if (avformat_open_input(&fmt, path.c_str(), nullptr, nullptr) < 0) {
+    std::cerr << "[MotionBench] Cannot open " << path << std::endl;
+    return false;
+  }
+  const int stream =
+      avformat_find_stream_info(fmt, nullptr) < 0
+          ? -1
+          : av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  if (stream < 0 ||
+      fmt->streams[stream]->codecpar->codec_id != AV_CODEC_ID_H264) {
+    std::cerr << "[MotionBench] No H.264 video in " << path << std::endl;
+    avformat_close_input(&fmt);
+    return false;
+  }
+
+  MotionVectorDecoder decoder(fmt->streams[stream]->codecpar);
+  if (!decoder.valid()) {
+    avformat_close_input(&fmt);
+    return false;
+  }
+  auto flow = MotionDetector::create(MotionEngine::OpticalFlow, settings);
+  auto vectors = MotionDetector::create(MotionEngine::MotionVectors, settings);
+  MotionDetectorResult flowResult, vectorResult;
+
+  const float threshold = settings.motion_threshold();
+  const cv::Mat noMask;
+  const std::vector<int> noRegions;
+  cv::Mat grayBuf[2], prevGray;
+  int cur = 0;
+  std::vector<MotionVector> blocks;
+
+  AVPacket *packet = av_packet_alloc();
+  while (packet && av_read_frame(fmt, packet) >= 0) {
+    if (packet->stream_index != stream) {
+      av_packet_unref(packet);
+      continue;
+    }
+    auto start = BenchClock::now();
+    const bool decoded =
+        decoder.decode(packet->data, packet->size, packet->pts);
+    report.decodeMs += elapsedMs(start);
+    av_packet_unref(packet);
+
+    const MotionVectorFrame &frame = decoder.frame();
+    if (!decoded || frame.luma.empty())
+      continue;
+    ++report.frames;
+
+    const cv::Size frameSize(frame.width, frame.height);
+    const cv::Size target = size.area() > 0 ? size : frameSize;
+    start = BenchClock::now();
+    cv::Mat &gray = grayBuf[cur];
+    if (target != frameSize)
+      cv::resize(frame.luma, gray, target, 0, 0, cv::INTER_AREA);
+    else
+      frame.luma.copyTo(gray);
+    report.prepareMs += elapsedMs(start);
+
+    if (frame.hasVectors && !prevGray.empty()) {
+      const float sx = float(target.width) / frame.width;
+      const float sy = float(target.height) / frame.height;
+      blocks.clear();
+      for (const MotionVector &v : frame.vectors)
+        blocks.push_back({cv::Point2f(v.from.x * sx, v.from.y * sy),
+                          cv::Point2f(v.to.x * sx, v.to.y * sy)});
+
+      const MotionDetectorInput in{gray,
+                                   prevGray,
+                                   noMask,
+                                   noRegions,
+                                   settings.noise_threshold(),
+                                   settings.feature_redetect_interval(),
+                                   settings.feature_min_survivor_ratio(),
+                                   false,
+                                   threshold,
+                                   &blocks,
+                                   frame.intraRatio};
+      runEngine(*flow, in, flowResult, threshold, report.flow);
+      runEngine(*vectors, in, vectorResult, threshold, report.vectors);
+      ++report.scored;
+      if ((flowResult.motion > threshold) ==
+          (vectorResult.motion > threshold))
+        ++report.agree;
+    } else {
+      flow->skipped();
+      vectors->skipped();
+    }
+    prevGray = gray;
+    cur ^= 1;
+  }
+  av_packet_free(&packet);
+  avformat_close_input(&fmt);
+  return true;
+}
+
+double perFrame(double ms, int frames) { return frames ? ms / frames : 0.0; }
+double percent(int n, int of) { return of ? 100.0 * n / of : 0.0; }
+
+void printReport(const std::string &name, const BenchReport &r) {
+  std::printf("%s: %d frames decoded, %d scored\n", name.c_str(), r.frames,
+              r.scored);
+  std::printf("  decode                  %8.3f ms/frame\n",
+              perFrame(r.decodeMs, r.frames));
+  std::printf("  optical_flow            %8.3f ms/frame (+ %.3f to scale "
+              "the luma), motion on %.1f%% of frames\n",
+              perFrame(r.flow.ms, r.scored), perFrame(r.prepareMs, r.frames),
+              percent(r.flow.motionFrames, r.scored));
+  std::printf("  motion_vectors          %8.3f ms/frame, fallback on %.1f%%, "
+              "motion on %.1f%% of frames\n",
+              perFrame(r.vectors.ms, r.scored),
+              percent(r.vectors.fallbacks, r.scored),
+              percent(r.vectors.motionFrames, r.scored));
+  std::printf("  agreement               %8.1f%%\n",
+              percent(r.agree, r.scored));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string settingsPath = "settings.json";
+  cv::Size size(0, 0);
+  std::vector<std::string> clips;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--settings" && i + 1 < argc) {
+      settingsPath = argv[++i];
+    } else if (arg == "--size" && i + 1 < argc) {
+      if (std::sscanf(argv[++i], "%dx%d", &size.width, &size.height) != 2) {
+        std::cerr << "--size expects WxH" << std::endl;
+        return 1;
+      }
+    } else {
+      clips.push_back(arg);
+    }
+  }
+  if (clips.empty()) {
+    std::cerr << "Usage: motionbench [--settings settings.json] [--size WxH] "
+                 "clip..."
+              << std::endl;
+    return 1;
+  }
+
+  Settings settings(settingsPath);
+  if (size.area() <= 0) {
+    // Same analysis size as the cameras by default
+    IntSize s = settings.motionFrameSize();
+    float scale = settings.motion_frame_scale();
+    if (scale <= 0.0f)
+      scale = 1.0f;
+    if (s.w > 0 && s.h > 0)
+      size = cv::Size(int(s.w * scale) & ~1, int(s.h * scale) & ~1);
+  }
+
+  BenchReport total;
+  int benched = 0;
+  for (const std::string &clip : clips) {
+    BenchReport report;
+    if (!benchClip(clip, settings, size, report))
+      continue;
+    printReport(clip, report);
+    total.add(report);
+    ++benched;
+  }
+  if (benched > 1)
+    printReport("total", total);
+  return benched ? 0 : 1;
+}